@@ -0,0 +1,75 @@
+#include "BenchAlloc.h"
+
+#include <cstdlib>
+#include <new>
+
+std::atomic<long long> allocations(0);
+std::atomic<long long> allocated(0);
+
+// Allocates the bytes at the alignment given, counting them
+// Memory with a larger alignment than malloc's is freed with Release aligned
+// Returns NULL if the memory can't be allocated
+static void* Allocate(std::size_t size, std::size_t alignment = 0)
+{
+	allocations++;
+	allocated += (long long)size;
+	size = size == 0 ? 1 : size;
+
+	if (alignment == 0)
+	{	return std::malloc(size);
+	}
+#ifdef _WIN32
+	return _aligned_malloc(size, alignment);
+#else
+	// The size of an aligned allocation is a multiple of its alignment
+	return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+}
+
+// Frees memory of Allocate
+static void Release(void* memory, bool aligned = false)
+{
+#ifdef _WIN32
+	if (aligned)
+	{	_aligned_free(memory);
+		return;
+	}
+#else
+	(void)aligned;
+#endif
+	std::free(memory);
+}
+
+// Allocates the bytes or throws std::bad_alloc
+static void* Require(std::size_t size, std::size_t alignment = 0)
+{	void* memory = Allocate(size, alignment);
+	if (memory == NULL)
+	{	throw std::bad_alloc();
+	}
+	return memory;
+}
+
+
+void* operator new(std::size_t size)                                   { return Require(size); }
+void* operator new[](std::size_t size)                                 { return Require(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept   { return Allocate(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return Allocate(size); }
+
+void* operator new(std::size_t size, std::align_val_t align)                                   { return Require(size, (std::size_t)align); }
+void* operator new[](std::size_t size, std::align_val_t align)                                 { return Require(size, (std::size_t)align); }
+void* operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept   { return Allocate(size, (std::size_t)align); }
+void* operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return Allocate(size, (std::size_t)align); }
+
+void operator delete(void* memory) noexcept                             { Release(memory); }
+void operator delete[](void* memory) noexcept                           { Release(memory); }
+void operator delete(void* memory, std::size_t) noexcept                { Release(memory); }
+void operator delete[](void* memory, std::size_t) noexcept              { Release(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept      { Release(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept    { Release(memory); }
+
+void operator delete(void* memory, std::align_val_t) noexcept                                { Release(memory, true); }
+void operator delete[](void* memory, std::align_val_t) noexcept                              { Release(memory, true); }
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept                   { Release(memory, true); }
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept                 { Release(memory, true); }
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept         { Release(memory, true); }
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept       { Release(memory, true); }
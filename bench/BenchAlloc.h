@@ -0,0 +1,14 @@
+#ifndef BENCHALLOC_H
+#define BENCHALLOC_H
+
+#include <atomic>
+
+// Allocations made by a benchmark, counted by the global operator new
+// BenchAlloc.cpp replaces every form of the global operators new and delete,
+// so a benchmark linking it counts the allocations of the whole program.
+// The operators live in a translation unit of their own, so the compiler
+// never sees a replaced delete next to the new it pairs with.
+extern std::atomic<long long> allocations;	// Number of allocations
+extern std::atomic<long long> allocated;	// Bytes allocated
+
+#endif
@@ -0,0 +1,146 @@
+#include <rpc-service/RPCService.h>
+#include <rpc-service/RPCClient.h>
+#include <rpc-service/RPCFunction.h>
+#include "BenchAlloc.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+typedef std::chrono::steady_clock clk;
+
+// Procedures dispatched during the benchmark
+int Add(int a, int b)
+{	return a + b;
+}
+
+int Length(int a, str data)
+{	return a + (int)data.size();
+}
+
+int View(int a, std::string_view data)
+{	return a + (int)data.size();
+}
+
+int Lookup(long long id, int version, str name)
+{	return (int)id + version + (int)name.size();
+}
+
+// Results of dispatching one request many times
+struct Report
+{
+	double allocs;			// Allocations per call
+	double bytes;			// Bytes allocated per call
+	double ns;				// Nanoseconds per call
+};
+
+// Dispatches the request through the service without any networking
+// Counts the allocations of the decode-and-invoke path of every call
+template<class Service>
+static Report run(Service& service, const str& request, int calls, uint flags = FRAME_METHOD)
+{
+	long long allocs = allocations;
+	long long bytes  = allocated;
+	auto start = clk::now();
+
+	for (int i = 0; i < calls; i++)
+	{	str reply = "";
+		service.Process(flags, request, reply);
+	}
+
+	auto end = clk::now();
+
+	Report report = Report{};
+	report.allocs = (double)(allocations - allocs) / calls;
+	report.bytes  = (double)(allocated - bytes) / calls;
+	report.ns     = std::chrono::duration<double, std::nano>(end - start).count() / calls;
+	return report;
+}
+
+// Calls the procedure through a client over loopback
+// The first calls open the connection and are left out of the counts, the
+// allocations of both the client and the server are counted
+template<class Arg>
+static Report call(RPCClient& client, int port, cstr function, const Arg& arg, int calls)
+{
+	int result = 0;
+	for (int i = 0; i < 100; i++)
+	{	client.Call("127.0.0.1", port, result, function, 3, arg);
+	}
+
+	long long allocs = allocations;
+	long long bytes  = allocated;
+	auto start = clk::now();
+
+	for (int i = 0; i < calls; i++)
+	{	client.Call("127.0.0.1", port, result, function, 3, arg);
+	}
+
+	auto end = clk::now();
+
+	Report report = Report{};
+	report.allocs = (double)(allocations - allocs) / calls;
+	report.bytes  = (double)(allocated - bytes) / calls;
+	report.ns     = std::chrono::duration<double, std::nano>(end - start).count() / calls;
+	return report;
+}
+
+// Prints a row of the results table
+static void print(const char* name, const Report& report)
+{
+	std::cout << std::left << std::setw(22) << name << std::right << std::fixed
+		<< std::setw(12) << std::setprecision(1) << report.allocs
+		<< std::setw(16) << std::setprecision(0) << report.bytes
+		<< std::setw(14) << std::setprecision(0) << report.ns << "\n";
+}
+
+// Measures the allocations and bytes copied per call while dispatching
+// requests with small arguments and with a large string argument, first
+// through the server alone and then through a client over loopback
+// Usage: dispatch_bench [calls] [string bytes]
+int main(int argc, char** argv)
+{
+	int calls = argc > 1 ? atoi(argv[1]) : 2000;
+	int size  = argc > 2 ? atoi(argv[2]) : 1 << 20;
+
+	auto functions = std::make_tuple(
+		MakeFunction("Add", Type<int>(), Add, std::tuple<Type<int>, Type<int> >()),
+		MakeFunction("Length", Type<int>(), Length, std::tuple<Type<int>, Type<str> >()),
+		MakeFunction("View", Type<int>(), View, std::tuple<Type<int>, Type<std::string_view> >()),
+		MakeFunction("Lookup", Type<int>(), Lookup, std::tuple<Type<long long>, Type<int>, Type<str> >()),
+		MakeFunction("LookupAccountByName", Type<int>(), Lookup, std::tuple<Type<long long>, Type<int>, Type<str> >())
+	);
+	RPCService<decltype(functions)> service(functions);
+
+	str small   = MethodRequest(MethodId("Add"), Package(3, 6));
+	str large   = MethodRequest(MethodId("Length"), Package(3, str(size, 'x')));
+	str view    = MethodRequest(MethodId("View"), Package(3, str(size, 'x')));
+	str lookup  = MethodRequest(MethodId("Lookup"), Package(1042LL, 7, str("user-42")));
+	str compact = MethodRequest(MethodId("Lookup"), Compact(1042LL, 7, str("user-42")));
+	str named   = "LookupAccountByName\n" + Package(1042LL, 7, str("user-42"));
+
+	std::cout << calls << " calls, " << size << " byte string\n\n";
+	std::cout << std::left << std::setw(22) << "request" << std::right
+		<< std::setw(12) << "allocs" << std::setw(16) << "bytes alloc'd" << std::setw(14) << "ns/call" << "\n";
+
+	print("two ints", run(service, small, calls));
+	print("int and string", run(service, large, calls));
+	print("int and string_view", run(service, view, calls));
+	print("id, int and name", run(service, lookup, calls));
+	print("same, compact", run(service, compact, calls, FRAME_METHOD | FRAME_COMPACT));
+	print("same, by long name", run(service, named, calls, 0));
+
+	if (service.Start(7983, 1, 2))
+	{	RPCClient client;
+		print("loopback two ints", call(client, 7983, "Add", 6, calls));
+		print("loopback string", call(client, 7983, "Length", str(size, 'x'), calls));
+		client.Clear();
+	}
+
+	std::cout << "\nid, int and name: " << lookup.size() << " bytes raw, " << compact.size() << " bytes compact\n";
+	std::cout << "buffer pool: " << Buffers().hits << " hits, " << Buffers().misses << " misses\n";
+
+	service.Stop();
+	return 0;
+}
@@ -0,0 +1,487 @@
+#include <rpc-service/RPCService.h>
+#include <rpc-service/RPCClient.h>
+#include <rpc-service/RPCFunction.h>
+#include "BenchAlloc.h"
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <ctime>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cstdlib>
+
+typedef std::chrono::steady_clock clk;
+
+// Procedures served during the benchmark
+float Divide(int a, int b)
+{	return (float)a / b;
+}
+
+str Echo(str data)
+{	return data;
+}
+
+// Calls made by the clients, in the proportions of the procedure mix
+// Call i of a client calls the procedure at i modulo the length of the mix,
+// so every run makes the same sequence of calls
+struct Workload
+{
+	std::vector<int> mix;	// Procedure of each call of a cycle, 0 for Divide and 1 for Echo
+	str payload;			// Argument of Echo
+	str name;				// Mix as given on the command line
+
+	// Returns true if call i echoes the payload
+	bool echo(int i) const
+	{	return mix[i % mix.size()] == 1;
+	}
+};
+
+// Reads a procedure mix like "divide:3,echo:1" into a workload
+// Procedures left out are not called, an empty mix only calls Divide
+static Workload parse(const str& mix, int payload)
+{
+	Workload work = Workload{};
+	work.payload = str(payload, 'x');
+	work.name    = mix;
+
+	std::stringstream items(mix);
+	str item;
+	while (std::getline(items, item, ','))
+	{	size_t colon = item.find(':');
+		str  name   = item.substr(0, colon);
+		int  weight = colon != str::npos ? atoi(item.c_str() + colon + 1) : 1;
+		int  index  = name == "echo" ? 1 : 0;
+
+		for (int i = 0; i < weight; i++)
+		{	work.mix.push_back(index);
+		}
+	}
+
+	if (work.mix.empty())
+	{	work.mix.push_back(0);
+		work.name = "divide:1";
+	}
+	return work;
+}
+
+// Results of one benchmark run
+struct Report
+{
+	str       mode;			// Name of the run
+	long long calls;		// Number of successful calls
+	long long failed;		// Number of failed calls
+	double    seconds;		// Wall time of the run
+	double    p50;			// Median latency in microseconds
+	double    p99;			// 99th percentile latency in microseconds
+	double    p999;			// 99.9th percentile latency in microseconds
+	double    cpu;			// Microseconds of CPU time per call, of the client and server together
+	double    allocs;		// Allocations per call, of the client and server together
+};
+
+// Counters read before a run, to measure the run against
+struct Meter
+{
+	clk::time_point start;	// Wall time
+	std::clock_t    cpu;	// CPU time of the process
+	long long       allocs;	// Allocations of the process
+
+	Meter() : start(clk::now()), cpu(std::clock()), allocs(allocations) {}
+};
+
+// Returns the latency at the percentile from sorted samples
+static double percentile(const std::vector<double>& sorted, double p)
+{
+	if (sorted.empty())
+	{	return 0;
+	}
+	size_t index = (size_t)(p * (sorted.size() - 1));
+	return sorted[index];
+}
+
+// Completes a report from the latencies of the successful calls and the
+// counters read before the run
+static Report finish(cstr mode, std::vector<double>& all, long long failed, const Meter& meter)
+{
+	auto end = clk::now();
+	double cpu = (double)(std::clock() - meter.cpu) / CLOCKS_PER_SEC;
+	long long allocs = allocations - meter.allocs;
+	long long total  = (long long)all.size() + failed;
+
+	std::sort(all.begin(), all.end());
+
+	Report report = Report{};
+	report.mode    = mode;
+	report.calls   = (long long)all.size();
+	report.failed  = failed;
+	report.seconds = std::chrono::duration<double>(end - meter.start).count();
+	report.p50     = percentile(all, 0.50);
+	report.p99     = percentile(all, 0.99);
+	report.p999    = percentile(all, 0.999);
+	report.cpu     = total > 0 ? cpu * 1e6 / total : 0;
+	report.allocs  = total > 0 ? (double)allocs / total : 0;
+	return report;
+}
+
+// Makes call i of the workload
+// Calls go through the client's pooled connections if a client is given,
+// otherwise the call opens its own connection
+static bool call(int port, const Workload& work, int i, RPCClient* pool)
+{
+	if (work.echo(i))
+	{	str result;
+		return pool != NULL
+			? pool->Call("127.0.0.1", port, result, "Echo", work.payload)
+			: RPC("127.0.0.1", port, result, "Echo", work.payload);
+	}
+
+	float result = 0;
+	return pool != NULL
+		? pool->Call("127.0.0.1", port, result, "Divide", 3, 6)
+		: RPC("127.0.0.1", port, result, "Divide", 3, 6);
+}
+
+// Runs a number of client threads calling the procedures against a service
+// Each client makes the same number of calls, one after the other
+static Report run(cstr mode, int port, int clients, int calls, const Workload& work, RPCClient* pool = NULL)
+{
+	std::vector<std::vector<double> > latencies(clients);
+	std::vector<long long> failures(clients, 0);
+	std::vector<std::thread> threads;
+
+	Meter meter;
+
+	for (int c = 0; c < clients; c++)
+	{	threads.push_back(std::thread([&, c]()
+		{	latencies[c].reserve(calls);
+			for (int i = 0; i < calls; i++)
+			{	auto begin = clk::now();
+				bool ok = call(port, work, i, pool);
+				auto end = clk::now();
+
+				if (ok)
+				{	latencies[c].push_back(std::chrono::duration<double, std::micro>(end - begin).count());
+				}
+				else
+				{	failures[c]++;
+				}
+			}
+		}));
+	}
+
+	for (size_t i = 0; i < threads.size(); i++)
+	{	threads[i].join();
+	}
+
+	std::vector<double> all;
+	long long failed = 0;
+	for (int c = 0; c < clients; c++)
+	{	all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+		failed += failures[c];
+	}
+
+	return finish(mode, all, failed, meter);
+}
+
+// Runs a number of client threads sending their calls in batches
+// Every call of a batch completes with the batch, so each one is counted
+// with the latency of its batch
+static Report runBatch(cstr mode, int port, int clients, int calls, int size, const Workload& work, RPCClient& client)
+{
+	std::vector<std::vector<double> > latencies(clients);
+	std::vector<long long> failures(clients, 0);
+	std::vector<std::thread> threads;
+
+	Meter meter;
+
+	for (int c = 0; c < clients; c++)
+	{	threads.push_back(std::thread([&, c]()
+		{	latencies[c].reserve(calls);
+			for (int i = 0; i < calls; i += size)
+			{	int count = calls - i < size ? calls - i : size;
+				RPCBatch batch = client.Batch("127.0.0.1", port);
+				for (int k = 0; k < count; k++)
+				{	if (work.echo(i + k))
+					{	batch.Call("Echo", work.payload);
+					}
+					else
+					{	batch.Call("Divide", 3, 6);
+					}
+				}
+
+				auto begin = clk::now();
+				RPCReplies replies = batch.Send();
+				auto end = clk::now();
+
+				for (int k = 0; k < count; k++)
+				{	if (replies.good(k))
+					{	latencies[c].push_back(std::chrono::duration<double, std::micro>(end - begin).count());
+					}
+					else
+					{	failures[c]++;
+					}
+				}
+			}
+		}));
+	}
+
+	for (size_t i = 0; i < threads.size(); i++)
+	{	threads[i].join();
+	}
+
+	std::vector<double> all;
+	long long failed = 0;
+	for (int c = 0; c < clients; c++)
+	{	all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+		failed += failures[c];
+	}
+
+	return finish(mode, all, failed, meter);
+}
+
+// Issues every call from a single thread with the asynchronous API
+// Keeps up to window calls in flight, the replies are completed by the
+// client's I/O thread
+static Report runAsync(cstr mode, int port, int total, int window, const Workload& work, RPCClient& client)
+{
+	std::vector<double> all;
+	std::mutex lock;
+	std::condition_variable signal;
+	long long failed = 0;
+	int inflight = 0;
+
+	all.reserve(total);
+	Meter meter;
+
+	for (int i = 0; i < total; i++)
+	{	{	std::unique_lock<std::mutex> guard(lock);
+			signal.wait(guard, [&] { return inflight < window; });
+			inflight++;
+		}
+
+		auto begin = clk::now();
+		auto done  = [&, begin](bool ok)
+		{	auto end = clk::now();
+			std::lock_guard<std::mutex> guard(lock);
+
+			if (ok)
+			{	all.push_back(std::chrono::duration<double, std::micro>(end - begin).count());
+			}
+			else
+			{	failed++;
+			}
+
+			inflight--;
+			signal.notify_one();
+		};
+
+		if (work.echo(i))
+		{	client.Async<str>("127.0.0.1", port, "Echo", work.payload).then([done](RPCResult<str>& result) { done(result.ok); });
+		}
+		else
+		{	client.Async<float>("127.0.0.1", port, "Divide", 3, 6).then([done](RPCResult<float>& result) { done(result.ok); });
+		}
+	}
+
+	{	std::unique_lock<std::mutex> guard(lock);
+		signal.wait(guard, [&] { return inflight == 0; });
+	}
+
+	return finish(mode, all, failed, meter);
+}
+
+// Times of a restart under load
+struct Restart
+{
+	str    mode;			// Name of the service restarted
+	double drain;			// Milliseconds taken by the drain
+	double start;			// Milliseconds taken to start again
+	double serving;			// Milliseconds until calls succeeded again
+	bool   drained;			// Flag of wether the calls in flight completed in time
+	long long failed;		// Calls failed while restarting
+};
+
+// Restarts the service while client threads keep calling it through pooled connections
+// Measures the time taken to drain the service and to start it again, and the
+// calls failed while it was restarting
+template<class Service>
+static Restart restart(cstr mode, Service& service, int port, int clients, int io, int workers, const Workload& work)
+{
+	RPCClient client(clients);
+	std::atomic<bool> running(true);
+	std::atomic<long long> calls(0);
+	std::atomic<long long> failed(0);
+	std::vector<std::thread> threads;
+
+	for (int c = 0; c < clients; c++)
+	{	threads.push_back(std::thread([&]()
+		{	for (int i = 0; running; i++)
+			{	if (call(port, work, i, &client))
+				{	calls++;
+				}
+				else
+				{	failed++;
+				}
+			}
+		}));
+	}
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+	Restart result = Restart{};
+	long long before = calls;
+	auto start = clk::now();
+	result.drained = service.Drain(1000);
+	auto stopped = clk::now();
+	bool started = service.Start(port, io, workers);
+	auto end = clk::now();
+
+	// Waits for the clients to complete calls on the restarted service
+	while (started && calls < before + 100 + clients)
+	{	std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	auto serving = clk::now();
+
+	running = false;
+	for (size_t i = 0; i < threads.size(); i++)
+	{	threads[i].join();
+	}
+	client.Clear();
+
+	result.mode    = mode;
+	result.drain   = std::chrono::duration<double, std::milli>(stopped - start).count();
+	result.start   = std::chrono::duration<double, std::milli>(end - stopped).count();
+	result.serving = std::chrono::duration<double, std::milli>(serving - start).count();
+	result.failed  = failed;
+	return result;
+}
+
+// Prints a row of the results table
+static void print(const Report& r)
+{
+	std::cout << std::left << std::setw(20) << r.mode << std::right
+		<< std::setw(12) << std::fixed << std::setprecision(0) << r.calls / r.seconds
+		<< std::setw(10) << std::setprecision(1) << r.p50
+		<< std::setw(10) << r.p99
+		<< std::setw(10) << r.p999
+		<< std::setw(10) << r.cpu
+		<< std::setw(10) << r.allocs
+		<< std::setw(8) << r.failed << "\n";
+}
+
+// Prints the times of a restart
+static void print(const Restart& r)
+{
+	std::cout << std::fixed << std::setprecision(1)
+		<< "restart under load, " << r.mode << ": drain " << r.drain << " ms"
+		<< (r.drained ? "" : " (timed out)")
+		<< ", start " << r.start << " ms"
+		<< ", serving again after " << r.serving << " ms"
+		<< ", " << r.failed << " failed calls\n";
+}
+
+// Writes the settings and results of the benchmark as a JSON object
+static void write(cstr path, int clients, int calls, int io, int workers, const Workload& work,
+	const std::vector<Report>& reports, const std::vector<Restart>& restarts)
+{
+	std::ofstream out(path);
+	out << std::fixed << std::setprecision(3)
+		<< "{\"clients\":" << clients << ",\"calls\":" << calls << ",\"io\":" << io << ",\"workers\":" << workers
+		<< ",\"payload\":" << work.payload.size() << ",\"mix\":\"" << work.name << "\",\"results\":[";
+
+	for (size_t i = 0; i < reports.size(); i++)
+	{	const Report& r = reports[i];
+		out << (i == 0 ? "" : ",")
+			<< "{\"mode\":\"" << r.mode << "\",\"calls\":" << r.calls << ",\"failed\":" << r.failed
+			<< ",\"calls_per_sec\":" << r.calls / r.seconds
+			<< ",\"p50_us\":" << r.p50 << ",\"p99_us\":" << r.p99 << ",\"p999_us\":" << r.p999
+			<< ",\"cpu_us_per_call\":" << r.cpu << ",\"allocs_per_call\":" << r.allocs << "}";
+	}
+
+	out << "],\"restarts\":[";
+	for (size_t i = 0; i < restarts.size(); i++)
+	{	const Restart& r = restarts[i];
+		out << (i == 0 ? "" : ",")
+			<< "{\"mode\":\"" << r.mode << "\",\"drain_ms\":" << r.drain << ",\"start_ms\":" << r.start
+			<< ",\"serving_ms\":" << r.serving << ",\"drained\":" << (r.drained ? "true" : "false")
+			<< ",\"failed\":" << r.failed << "}";
+	}
+
+	out << "]}\n";
+}
+
+// Compares the thread-per-request server with the event mode over loopback
+// The event mode is measured with a connection per call, with pooled connections,
+// with asynchronous calls pipelined from a single thread, and with batches of
+// 100 calls sent in one frame
+// Both modes are then restarted under load with a drain
+// Clients call Divide and Echo in the proportions of the mix, Echo with a
+// payload of the size given. The results are also written to the JSON file
+// if one is given.
+// Usage: rpc_bench [clients] [calls per client] [io threads] [worker threads] [payload bytes] [mix] [json file]
+int main(int argc, char** argv)
+{
+	int clients = argc > 1 ? atoi(argv[1]) : 4;
+	int calls   = argc > 2 ? atoi(argv[2]) : 1000;
+	int io      = argc > 3 ? atoi(argv[3]) : 1;
+	int workers = argc > 4 ? atoi(argv[4]) : 4;
+	int payload = argc > 5 ? atoi(argv[5]) : 64;
+	Workload work = parse(argc > 6 ? argv[6] : "divide:1", payload);
+	cstr json   = argc > 7 ? argv[7] : NULL;
+
+	auto RPCs = std::make_tuple(
+		MakeFunction("Divide", Type<float>(), Divide, std::tuple<Type<int>, Type<int> >()),
+		MakeFunction("Echo", Type<str>(), Echo, std::tuple<Type<str> >())
+	);
+
+	std::vector<Report>  reports;
+	std::vector<Restart> restarts;
+
+	std::cout << clients << " clients x " << calls << " calls, mix " << work.name << ", " << payload << " byte payload\n\n";
+	std::cout << std::left << std::setw(20) << "mode" << std::right
+		<< std::setw(12) << "calls/s" << std::setw(10) << "p50 us"
+		<< std::setw(10) << "p99 us" << std::setw(10) << "p999 us"
+		<< std::setw(10) << "cpu us" << std::setw(10) << "allocs" << std::setw(8) << "failed" << "\n";
+
+	auto threaded = MakeIRPCService(RPCs);
+	if (threaded.Start(7981))
+	{	reports.push_back(run("thread-per-request", 7981, clients, calls, work));
+		print(reports.back());
+	}
+
+	auto evented = MakeIRPCService(RPCs);
+	if (evented.Start(7982, io, workers))
+	{	reports.push_back(run("event loop", 7982, clients, calls, work));
+		print(reports.back());
+
+		RPCClient client(clients);
+		reports.push_back(run("event loop, pooled", 7982, clients, calls, work, &client));
+		print(reports.back());
+		reports.push_back(runAsync("event loop, async", 7982, clients * calls, 64, work, client));
+		print(reports.back());
+		reports.push_back(runBatch("event loop, batch", 7982, clients, calls, 100, work, client));
+		print(reports.back());
+		client.Clear();
+	}
+
+	std::cout << "\n";
+	restarts.push_back(restart("thread-per-request", threaded, 7981, clients, 0, 0, work));
+	print(restarts.back());
+	restarts.push_back(restart("event loop", evented, 7982, clients, io, workers, work));
+	print(restarts.back());
+
+	threaded.Delete();
+	evented.Delete();
+
+	if (json != NULL)
+	{	write(json, clients, calls, io, workers, work, reports, restarts);
+		std::cout << "\nresults written to " << json << "\n";
+	}
+
+	return 0;
+}
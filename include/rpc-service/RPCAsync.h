@@ -0,0 +1,174 @@
+#ifndef RPCASYNC_H
+#define RPCASYNC_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#ifdef __cpp_impl_coroutine
+#include <coroutine>
+#include <exception>
+#endif
+
+
+// Outcome of an asynchronous call
+// The value is only meaningful if the call succeeded
+template<class Return>
+struct RPCResult
+{
+	bool   ok;					// Flag of wether the call succeeded
+	Return value;				// Result of the function called
+	bool   expired;				// Flag of wether the call failed as its deadline passed first
+	bool   overloaded;			// Flag of wether the server rejected the call to shed load
+};
+
+template<>
+struct RPCResult<void>
+{
+	bool ok;					// Flag of wether the call succeeded
+	bool expired;				// Flag of wether the call failed as its deadline passed first
+	bool overloaded;			// Flag of wether the server rejected the call to shed load
+};
+
+
+// State shared between an asynchronous call and the handles waiting for it
+// Completed exactly once, usually from the client's I/O thread
+template<class Return>
+struct RPCState
+{
+	std::mutex lock;						// Guards the fields below
+	std::condition_variable signal;			// Wakes threads waiting for the result
+	bool done;								// Flag of wether the call completed
+	RPCResult<Return> result;				// Outcome of the call
+	std::function<void()> continuation;		// Function run once the call completes
+
+	RPCState() : done(false), result() {}
+
+	// Stores the outcome, wakes the waiting threads and runs the continuation
+	void Complete(RPCResult<Return> outcome)
+	{
+		std::function<void()> next;
+		{	std::lock_guard<std::mutex> guard(lock);
+			result = std::move(outcome);
+			done   = true;
+			next.swap(continuation);
+		}
+
+		signal.notify_all();
+		if (next)
+		{	next();
+		}
+	}
+
+	// Sets the function to run once the call completes
+	// Returns false without keeping it if the call already completed
+	bool Defer(std::function<void()> fn)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (!done)
+		{	continuation = std::move(fn);
+		}
+		return !done;
+	}
+
+	// Sets the function to run once the call completes
+	// Runs it straight away if the call already completed
+	void Then(std::function<void()> fn)
+	{
+		if (!Defer(fn))
+		{	fn();
+		}
+	}
+};
+
+
+#ifdef __cpp_impl_coroutine
+template<class Return> class RPCTask;
+
+// Promise of a coroutine returning an RPCTask
+// Coroutines start straight away and free themselves once they finish
+template<class Return>
+struct RPCPromiseBase
+{
+	std::shared_ptr<RPCState<Return> > state = std::make_shared<RPCState<Return> >();
+
+	RPCTask<Return> get_return_object() { return RPCTask<Return>(state); }
+	std::suspend_never initial_suspend() noexcept { return {}; }
+	std::suspend_never final_suspend() noexcept { return {}; }
+	void unhandled_exception() { std::terminate(); }
+};
+
+template<class Return>
+struct RPCPromise : RPCPromiseBase<Return>
+{
+	void return_value(Return value) { this->state->Complete(RPCResult<Return>{ true, std::move(value), false, false }); }
+	void return_value(RPCResult<Return> result) { this->state->Complete(std::move(result)); }
+};
+
+template<>
+struct RPCPromise<void> : RPCPromiseBase<void>
+{
+	void return_void() { state->Complete(RPCResult<void>{ true, false, false }); }
+};
+#endif
+
+
+// Handle to an asynchronous call
+// Can be waited on like a future, given a continuation, or awaited with
+// co_await from a coroutine, which is then resumed on the thread completing
+// the call. A handle supports a single continuation or awaiting coroutine.
+// Waiting for a call from the client's I/O thread would never complete.
+template<class Return>
+class RPCTask
+{
+public:
+	std::shared_ptr<RPCState<Return> > state;	// State shared with the call
+
+	// Public constructors
+	RPCTask() : state(std::make_shared<RPCState<Return> >()) {}
+	RPCTask(std::shared_ptr<RPCState<Return> > _state) : state(_state) {}
+
+	// Returns true if the call completed
+	bool ready()
+	{	std::lock_guard<std::mutex> guard(state->lock);
+		return state->done;
+	}
+
+	// Blocks the thread until the call completes
+	void wait()
+	{	std::unique_lock<std::mutex> guard(state->lock);
+		state->signal.wait(guard, [this] { return state->done; });
+	}
+
+	// Blocks the thread until the call completes or the time runs out
+	// Returns true if the call completed
+	bool wait_for(int milliseconds)
+	{	std::unique_lock<std::mutex> guard(state->lock);
+		return state->signal.wait_for(guard, std::chrono::milliseconds(milliseconds), [this] { return state->done; });
+	}
+
+	// Blocks the thread until the call completes and returns its outcome
+	RPCResult<Return> get()
+	{	wait();
+		return state->result;
+	}
+
+	// Runs the function with the outcome once the call completes
+	void then(std::function<void(RPCResult<Return>&)> fn)
+	{	auto shared = state;
+		state->Then([shared, fn]() { fn(shared->result); });
+	}
+
+#ifdef __cpp_impl_coroutine
+	typedef RPCPromise<Return> promise_type;
+
+	// Awaiting the handle suspends the coroutine until the call completes
+	bool await_ready() { return ready(); }
+	bool await_suspend(std::coroutine_handle<> handle) { return state->Defer([handle]() { handle.resume(); }); }
+	RPCResult<Return> await_resume() { return state->result; }
+#endif
+};
+
+#endif
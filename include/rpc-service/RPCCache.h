@@ -0,0 +1,101 @@
+#ifndef RPCCACHE_H
+#define RPCCACHE_H
+
+#include "RPCStats.h"
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+typedef std::string   str;
+typedef const char*   cstr;
+typedef unsigned char byte;
+typedef unsigned int  uint;
+
+// Number of independently locked parts of the cache
+#define CACHE_SHARDS 16
+
+// Bytes of replies cached by default
+#define CACHE_BYTES (64 << 20)
+
+// Bytes counted for every entry on top of its parameters and reply
+#define CACHE_OVERHEAD 128
+
+
+// Call of a function with its parameters, in the encoding they were sent in
+// The parameters are viewed, either in the request or in the entry holding them
+struct RPCCacheKey
+{
+	uint method;					// Function called, unique within the cache
+	bool compact;					// Flag of wether the parameters and reply use the compact encoding
+	std::string_view params;		// Marshalled parameters
+
+	bool operator==(const RPCCacheKey& other) const
+	{	return method == other.method && compact == other.compact && params == other.params;
+	}
+};
+
+// Hashes the parameters together with the function and the encoding
+struct RPCCacheHash
+{
+	size_t operator()(const RPCCacheKey& key) const
+	{	size_t hash = std::hash<std::string_view>()(key.params);
+		return hash ^ ((size_t)key.method * 0x9E3779B97F4A7C15ull + (key.compact ? 1 : 0));
+	}
+};
+
+
+// Reply of a call kept in the cache
+struct RPCCacheEntry
+{
+	uint method;					// Function called, unique within the cache
+	bool compact;					// Flag of wether the parameters and reply use the compact encoding
+	str  params;					// Marshalled parameters of the call
+	str  reply;						// Marshalled result of the call
+	RPCClock::time_point expires;	// Time the reply goes stale
+};
+
+
+// Part of the cache holding the calls whose keys hash to it
+// Entries are kept from the most to the least recently used
+struct RPCCacheShard
+{
+	std::mutex lock;					// Guards the entries of the shard
+	std::list<RPCCacheEntry> entries;	// Entries by recency
+	std::unordered_map<RPCCacheKey, std::list<RPCCacheEntry>::iterator, RPCCacheHash> index;	// Entries by call, keyed by views of their parameters
+	size_t bytes;						// Bytes counted for the entries
+};
+
+
+// Replies of calls to functions whose result only depends on their parameters
+// The replies are kept marshalled, so a hit is answered with their bytes
+// without decoding the parameters or running the function. Calls are spread
+// over shards locked on their own, each bounded to its part of the bytes
+// and evicting its least recently used calls. Replies older than the time
+// to live are dropped when they're next looked up.
+class RPCCache
+{
+public:
+	RPCCacheShard shards[CACHE_SHARDS];	// Calls spread by hash
+	size_t capacity;					// Largest number of bytes of each shard
+	RPCClock::duration ttl;				// Time a reply is kept, 0 to keep it until evicted
+	std::atomic<unsigned long long> evictions;	// Number of replies evicted for room
+
+	// Public constructors
+	RPCCache(size_t bytes, RPCClock::duration _ttl);
+
+	// Public methods
+	bool   Get(const RPCCacheKey& key, str& reply, RPCClock::time_point now);
+	void   Put(const RPCCacheKey& key, const str& reply, RPCClock::time_point now);
+	size_t Bytes();
+	size_t size();
+
+	// Private methods
+	void   Erase(RPCCacheShard& shard, std::list<RPCCacheEntry>::iterator entry);
+	static size_t Cost(const RPCCacheEntry& entry);
+};
+
+#endif
@@ -0,0 +1,372 @@
+#ifndef RPCCLIENT_H
+#define RPCCLIENT_H
+
+#include "RPCService.h"
+#include "RPCAsync.h"
+#include "XReactor.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+typedef std::string   str;
+typedef const char*   cstr;
+typedef unsigned char byte;
+typedef unsigned int  uint;
+
+// Callback completing a call with the flags and the bytes of its reply
+// The error flag is set if the call failed, along with the expired flag if
+// its deadline passed first
+typedef std::function<void(uint flags, str& reply)> RPCDoneFn;
+
+// Largest number of nodes of completed requests kept for new requests
+#define PENDING_SPARE 1024
+
+
+// Connection to an endpoint kept open between calls
+struct Connection
+{
+	std::shared_ptr<XPeer> peer;				// Connection watched by the client's reactor
+	std::chrono::steady_clock::time_point used;	// Time the connection last completed a call
+};
+
+
+// Call of a shared function in flight, along with the identical calls waiting for its reply
+struct RPCFlight
+{
+	uint method;					// Id of the function
+	bool compact;					// Flag of wether the parameters and reply use the compact encoding
+	str  params;					// Marshalled parameters of the call
+	std::vector<RPCDoneFn> waiters;	// Functions completing the calls sharing the reply
+};
+
+
+// Pool of connections to a single endpoint
+// Calls share the connections and go to the one with the fewest calls in
+// flight. A new connection is opened while every connection is busy, up to
+// maxSize, without holding up the calls using the others. Connections idle
+// for longer than the timeout, or closed by the server, are dropped.
+// The pool also holds the calls of shared functions to the endpoint that
+// are in flight, and the results of those cached.
+class RPCPool
+{
+public:
+	str  address;				// IPv4 Address of the endpoint
+	int  port;					// Port of the endpoint
+	int  maxSize;				// Maximum number of open connections
+	int  idleTimeout;			// Milliseconds an idle connection is kept open
+	int  ctime;					// Milliseconds allowed to establish a connection
+	int  zeroCopy;				// Smallest request sent without copying, 0 to copy every request
+	size_t frameMax;			// Largest reply payload accepted, past which the connection is closed
+
+	std::mutex lock;				// Guards the connections
+	std::condition_variable signal;	// Wakes the calls waiting for a connection being opened
+	std::vector<Connection> conns;	// Open connections to the endpoint
+	int  opening;					// Number of connections being opened
+
+	std::unique_ptr<RPCCache> cache;	// Results of the shared functions, NULL if they're not cached
+	std::mutex flightLock;				// Guards the calls in flight
+	std::unordered_map<RPCCacheKey, RPCFlight*, RPCCacheHash> flights;	// Shared calls in flight, keyed by views of their parameters
+
+	// Public constructors
+	RPCPool(const str _address, const int _port, const int _maxSize, const int _idleTimeout, const int _ctime);
+
+	// Public methods
+	std::shared_ptr<XPeer> Acquire(XReactor& reactor);
+	void Release(XPeer* peer);
+	void Drop(XPeer* peer);
+	void Clear(XReactor& reactor, std::vector<std::shared_ptr<XPeer> >& closed);
+	void Land(RPCFlight* flight, uint flags, str& reply);
+};
+
+
+// Request in flight waiting for its reply
+struct RPCPending
+{
+	std::shared_ptr<XPeer> peer;	// Connection the request was sent on
+	RPCPool*  pool;					// Pool the connection belongs to
+	RPCDoneFn done;					// Function completing the call
+	RPCClock::time_point deadline;	// Time the call stops waiting for its reply
+};
+
+
+class RPCBatch;
+
+
+// Client keeping connections open to the servers it calls
+// Connections are pooled per endpoint and multiplexed: many requests can be
+// in flight on a connection at once, and every request carries an id. The
+// client's I/O thread reads the replies and completes the request with the
+// same id, in whatever order the server finishes them.
+// Calls with a timeout send it to the server, and are failed as expired by
+// the I/O thread once it passed. Calls made while a function of a service
+// runs end no later than the function's own caller.
+// Calls of shared functions that are identical to a call in flight to the
+// same endpoint wait for its reply instead of sending their own, and their
+// results can be cached for a time to live.
+// The client is safe to share between threads.
+class RPCClient
+{
+public:
+	int maxSize;					// Maximum number of connections per endpoint
+	int idleTimeout;				// Milliseconds an idle connection is kept open
+	int ctime;						// Milliseconds allowed to establish a connection
+	int zeroCopy;					// Smallest request sent without copying, 0 to copy every request
+	size_t frameMax;				// Largest reply payload accepted, past which the connection is closed
+	int timeout;					// Milliseconds a call waits for its reply, 0 to wait forever
+	bool compact;					// Flag of wether calls use the compact encoding
+	int cacheTTL;					// Milliseconds the results of shared functions are cached, 0 to not cache them
+	size_t cacheBytes;				// Largest number of bytes of cached results per endpoint
+
+	XReactor reactor;				// Event loop reading the replies
+	std::atomic<uint> nextId;		// Id of the next request
+
+	std::mutex lock;						// Guards the map of pools
+	std::map<str, RPCPool*> pools;			// Pools of connections by endpoint
+
+	std::mutex pendingLock;							// Guards the requests in flight
+	std::unordered_map<uint, RPCPending> pending;	// Requests in flight by id
+	std::vector<std::unordered_map<uint, RPCPending>::node_type> spare;	// Nodes of completed requests
+	RPCClock::time_point expiry;					// Earliest deadline of the requests in flight
+
+	std::unordered_set<uint> shared;				// Ids of the functions whose identical calls are shared
+	std::atomic<unsigned long long> hits;			// Number of calls answered from the cache
+	std::atomic<unsigned long long> joined;			// Number of calls that waited for an identical call in flight
+
+	// Public constructors
+	RPCClient(int _maxSize = 8, int _idleTimeout = 30000, int _ctime = XSOCKET_CTIME);
+	~RPCClient();
+
+	// Returns the pool of connections to an endpoint, creating it if needed
+	RPCPool* Pool(cstr address, int port);
+
+	// Shares the calls of the function whose result only depends on its parameters
+	// Identical calls to an endpoint share one request while it's in flight,
+	// and get its cached result for cacheTTL milliseconds after. Functions are
+	// shared, and the cache set up, before the client is used by other threads
+	void Share(str function);
+
+	// Closes every connection of the client
+	// Calls in flight on them fail
+	void Clear();
+
+	// Sends the request over a pooled connection without waiting for the reply
+	// The callback is called exactly once, from the client's I/O thread when
+	// the reply arrives or the deadline passes, or right away if the request
+	// could not be sent
+	// The flags tell the server if the request starts with a function id
+	void Send(cstr address, int port, const str& request, RPCDoneFn done, uint flags = 0);
+
+	// Sends the request made of the slices one after the other
+	// The slices are written straight to the connection without being copied
+	void Send(cstr address, int port, const XSlice* request, const int count, RPCDoneFn done, uint flags = 0);
+
+	// Sends the request over a pooled connection and waits for the reply
+	// Returns false if the call failed or timed out
+	bool Exchange(cstr address, int port, const str& request, str& reply, uint flags = 0);
+	bool Exchange(cstr address, int port, const XSlice* request, const int count, str& reply, uint flags = 0);
+
+	// Sends a call of the function with the marshalled parameters
+	// Calls of shared functions are answered from the cache, or wait for an
+	// identical call in flight, if they can be
+	void Request(cstr address, int port, uint method, const str& params, RPCDoneFn done);
+	bool Exchange(cstr address, int port, uint method, const str& params, str& reply);
+
+	// Deconstructs parameters into a Byte array
+	// Sends the request over a pooled connection and waits for the result
+	// The result is never an array, so a literal name goes to the overload below
+	template<class Return, class... Args> requires (!std::is_array_v<Return>)
+	bool Call(cstr address, int port, Return &data, str function, const Args&... args)
+	{
+		str params = Pack(args...);
+		str result = "";
+
+		bool ok = Exchange(address, port, MethodId(function.c_str()), params, result)
+			&& Extract(result, compact, data);
+
+		Buffers().Release(params);
+		Buffers().Release(result);
+		return ok;
+	}
+
+	// Deconstructs parameters into a Byte array
+	// Sends the request over a pooled connection and waits for it to complete
+	// The name is a C string, so a string result is never taken for the name
+	template<class... Args>
+	bool Call(cstr address, int port, cstr function, const Args&... args)
+	{
+		str params = Pack(args...);
+		str result = "";
+
+		bool ok = Exchange(address, port, MethodId(function), params, result);
+
+		Buffers().Release(params);
+		Buffers().Release(result);
+		return ok;
+	}
+
+	// Deconstructs parameters into a Byte array
+	// Sends the request without waiting and returns a handle to the result
+	// The handle is completed from the client's I/O thread
+	template<class Return, class... Args>
+	RPCTask<Return> Async(cstr address, int port, str function, const Args&... args)
+	{
+		RPCTask<Return> task;
+		auto state = task.state;
+		bool encoding = compact;
+		str  params = Pack(args...);
+
+		Request(address, port, MethodId(function.c_str()), params, [state, encoding](uint flags, str& reply)
+		{	RPCResult<Return> result = RPCResult<Return>();
+			result.ok = (flags & FRAME_ERROR) == 0;
+			result.expired = (flags & FRAME_EXPIRED) != 0;
+			result.overloaded = (flags & FRAME_OVERLOADED) != 0;
+			Decode(reply, encoding, result);
+			state->Complete(std::move(result));
+		});
+
+		Buffers().Release(params);
+		return task;
+	}
+
+	// Returns an empty batch of calls to the endpoint
+	// Calls added to the batch are sent together in one frame
+	RPCBatch Batch(cstr address, int port);
+
+	// Packages the parameters in the client's encoding
+	template<class... Args>
+	str Pack(const Args&... args)
+	{	return compact ? Compact(args...) : Package(args...);
+	}
+
+	// Returns the flags of a call's frame
+	uint Flags()
+	{	return FRAME_METHOD | (compact ? FRAME_COMPACT : 0);
+	}
+
+	// Unmarshalls the reply of a successful call into the result
+	// The call fails if the reply is cut short
+	template<class Return>
+	static void Decode(str& reply, bool compact, RPCResult<Return>& result)
+	{	if (result.ok)
+		{	result.ok = Extract(reply, compact, result.value);
+		}
+	}
+
+	static void Decode(str&, bool, RPCResult<void>&)
+	{
+	}
+
+	// Private methods
+	RPCClock::time_point Deadline();
+	void Track(uint id, RPCPending call);
+	bool Untrack(uint id, RPCPending& call);
+	int  Expire();
+	void Receive(std::shared_ptr<XPeer> peer, std::vector<Frame>& frames);
+	void Closed(std::shared_ptr<XPeer> peer);
+	void Fail(XPeer* peer);
+};
+
+
+// Result of a call in the reply of a batch
+struct RPCReply
+{
+	size_t offset;				// Position of the result in the reply
+	size_t size;				// Number of bytes of the result
+	uint   flags;				// Flags of the result, with the error flag if the call failed
+};
+
+
+// Replies of the calls of a batch, in the order the calls were added
+class RPCReplies
+{
+public:
+	bool ok;						// Flag of wether the batch was answered
+	bool compact;					// Flag of wether the results use the compact encoding
+	str  data;						// Payload of the batch's reply
+	std::vector<RPCReply> replies;	// Results of the calls within the payload
+
+	// Public constructors
+	RPCReplies() : ok(false), compact(false) {}
+
+	// Public methods
+	bool   Parse();
+	size_t size();
+	bool   good(size_t index);
+
+	// Unmarshalls the result of the call at the index
+	// Returns false if the call failed or its result is cut short
+	template<class Return>
+	bool Get(size_t index, Return& value)
+	{	if (!good(index))
+		{	return false;
+		}
+
+		return Extract(std::string_view(data).substr(replies[index].offset, replies[index].size), compact, value);
+	}
+};
+
+
+// Calls of functions sent to an endpoint in one frame and answered in one reply
+// The server runs the calls one after the other, or at the same time on its
+// workers if the batch is parallel, and returns every result in the order
+// the calls were added. Calls are added by chaining:
+//     client.Batch("127.0.0.1", 7971).Call("Divide", 3, 6).Call("Divide", 1, 2).Send()
+class RPCBatch
+{
+public:
+	RPCClient* client;			// Client sending the batch
+	str  address;				// IPv4 Address of the endpoint
+	int  port;					// Port of the endpoint
+	str  calls;					// Payload of the batch
+	size_t count;				// Number of calls in the batch
+	bool parallel;				// Flag of wether the calls may run at the same time
+	bool compact;				// Flag of wether the calls use the compact encoding
+
+	// Public constructors
+	RPCBatch(RPCClient* _client, cstr _address, int _port);
+	~RPCBatch();
+
+	// Deconstructs parameters into a Byte array
+	// Adds a call of the function to the batch
+	template<class... Args>
+	RPCBatch& Call(str function, const Args&... args)
+	{
+		str params = compact ? Compact(args...) : Package(args...);
+		AppendCall(calls, MethodId(function.c_str()), params);
+		Buffers().Release(params);
+
+		count++;
+		return *this;
+	}
+
+	// Public methods
+	RPCBatch& Parallel(bool enabled = true);
+	RPCReplies Send();
+	RPCTask<RPCReplies> Async();
+
+	// Private methods
+	uint Flags();
+};
+
+
+// Client shared by the asynchronous calls made without a client
+RPCClient& DefaultClient();
+
+// Deconstructs parameters into a Byte array
+// Sends the request through the default client without waiting
+// Returns a handle to the result, completed from the client's I/O thread
+template<class Return, class... Args>
+RPCTask<Return> AsyncRPC(cstr address, int port, str function, const Args&... args)
+{	return DefaultClient().Async<Return>(address, port, function, args...);
+}
+
+#endif
@@ -0,0 +1,181 @@
+#ifndef RPCFRAME_H
+#define RPCFRAME_H
+
+#include "XSocket.h"
+#include "XBuffer.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+typedef std::string   str;
+typedef const char*   cstr;
+typedef unsigned char byte;
+typedef unsigned int  uint;
+
+// Size of the header in front of every message
+#define FRAME_HEADER 16
+
+// Largest payload accepted in a frame by default
+#define FRAME_MAX (8 << 20)
+
+// Smallest number of payload bytes read at once by a blocking receive
+#define FRAME_CHUNK 65536
+
+// Flags of a frame
+#define FRAME_ERROR 0x01		// The request failed and the payload holds no result
+#define FRAME_METHOD 0x02		// The request starts with the id of the function instead of its name
+#define FRAME_BATCH 0x04		// The payload holds a list of calls, or of their replies
+#define FRAME_PARALLEL 0x08		// The calls of the batch may run at the same time
+#define FRAME_COMPACT 0x10		// The parameters and results use the compact encoding
+#define FRAME_EXPIRED 0x20		// The deadline of the request passed before it ran, set along with the error flag
+#define FRAME_OVERLOADED 0x40	// The server rejected the request to shed load, set along with the error flag
+
+// Size of the function id at the start of a request
+#define METHOD_SIZE 4
+
+// Largest number of slices of payload in a frame sent without copying
+#define FRAME_SLICES 8
+
+// Size of the length in front of every call in a batch
+#define BATCH_CALL 4
+
+// Size of the length and flags in front of every reply in a batch
+#define BATCH_REPLY 8
+
+
+// Header in front of every message on the wire
+// Encoded as four little-endian 32 bit integers
+// The timeout is relative to when the frame is received, so the caller and
+// the server need no synchronized clocks
+struct FrameHeader
+{
+	uint length;				// Number of bytes of payload following the header
+	uint id;					// Identifier of the request, echoed by the reply
+	uint flags;					// Flags describing the frame
+	uint timeout;				// Milliseconds the caller waits for the reply, 0 if it waits forever
+};
+
+
+// Writes the header into the first FRAME_HEADER bytes of the buffer
+void WriteHeader(char* buffer, const FrameHeader header);
+
+// Reads the header from the first FRAME_HEADER bytes of the buffer
+FrameHeader ReadHeader(cstr buffer);
+
+// Builds a complete frame of a header followed by the payload
+// The frame is a pooled buffer that can be released once it was sent
+str MakeFrame(const uint id, const uint flags, const str& payload);
+
+// Sends a complete frame through the socket
+// Returns true if the frame was sent successfully
+bool SendFrame(IXSocket conn, const uint id, const uint flags, const str& payload);
+
+
+// Frame made of its encoded header and slices of the payload
+// Sent with a single vectored send, without copying the payload. The first
+// slice points to the header, so the frame must not be copied once made.
+struct FrameSlices
+{
+	char   header[FRAME_HEADER];			// Encoded header of the frame
+	XSlice slices[FRAME_SLICES + 1];		// Header followed by the payload
+	int    count;							// Number of slices in use
+};
+
+// Describes a frame whose payload is the slices one after the other
+// Slices past FRAME_SLICES are left out
+void MakeFrame(FrameSlices& frame, const uint id, const uint flags, const XSlice* payload, const int count, const uint timeout = 0);
+
+// Sends a complete frame whose payload is the slices one after the other
+// Returns true if the frame was sent successfully
+bool SendFrame(IXSocket conn, const uint id, const uint flags, const XSlice* payload, const int count, const uint timeout = 0);
+
+// Blocks the thread until a complete frame is received
+// The payload grows as its bytes arrive, up to the length in the header
+// Returns false if the connection failed or the payload is larger than max
+bool RecvFrame(IXSocket conn, FrameHeader& header, str& payload, const size_t max = FRAME_MAX);
+
+
+// Returns the id sent in place of the name of a function
+// The id is the 32 bit FNV-1a hash of the name, so clients and servers agree
+// on it without exchanging a table, and it can be computed at compile time
+constexpr uint MethodId(cstr name)
+{
+	uint hash = 2166136261u;
+	for (; *name != 0; name++)
+	{	hash = (hash ^ (byte)*name) * 16777619u;
+	}
+	return hash;
+}
+
+// Builds the payload of a request calling a function by its id
+// The request is a pooled buffer that can be released once it was sent
+str MethodRequest(const uint method, const str& params);
+
+// Writes the id of a function into the first METHOD_SIZE bytes of the buffer
+void WriteMethod(char* buffer, const uint method);
+
+// Reads the id of the function from the start of a request's payload
+uint ReadMethod(cstr payload);
+
+
+// Payload of a request calling a function by its id, made of the encoded id
+// and the parameters. The first slice points to the id, so the request must
+// not be copied once made.
+struct MethodSlices
+{
+	char   id[METHOD_SIZE];			// Encoded id of the function
+	XSlice slices[2];				// Id followed by the parameters
+};
+
+// Describes a request calling a function by its id without copying the parameters
+void MakeRequest(MethodSlices& request, const uint method, const str& params);
+
+
+// Appends a call of a function by its id to the payload of a batch
+// Every call is its length followed by the id and the parameters
+void AppendCall(str& batch, const uint method, const str& params);
+
+// Appends the reply of a call to the payload of a batch's reply
+// Every reply is its length and flags followed by the result
+void AppendReply(str& batch, const uint flags, std::string_view reply);
+
+// Takes the next call off the front of a batch
+// Returns false at the end of the batch, or if the call is cut short
+bool NextCall(std::string_view& batch, std::string_view& call);
+
+// Takes the next reply off the front of a batch's reply
+// Returns false at the end of the reply, or if the reply is cut short
+bool NextReply(std::string_view& batch, uint& flags, std::string_view& reply);
+
+
+// Frame with its header and payload
+struct Frame
+{
+	FrameHeader header;			// Header of the frame
+	str         payload;		// Bytes following the header
+};
+
+
+// Streaming decoder turning the bytes read from a connection into frames
+// Handles frames split across reads as well as many frames in a single read.
+// The buffer grows with the bytes received rather than with the length a
+// header announces. Buffers come from the pool and are handed over with the
+// frames.
+class FrameDecoder
+{
+public:
+	str    buffer;				// Bytes received but not decoded yet
+	size_t offset;				// Position of the next frame in the buffer
+	size_t max;					// Largest payload accepted in a frame
+	bool   failed;				// Flag of wether the stream held an invalid frame
+
+	// Public constructors
+	FrameDecoder(const size_t _max = FRAME_MAX);
+
+	// Public methods
+	void Feed(cstr data, const size_t size);
+	bool Next(Frame& frame);
+};
+
+#endif
@@ -16,16 +16,19 @@ public:
 	Return result;		// Retrun type of the function
 	Funct  funct;		// Function pointer to the function
 	Params params;		// Parameter type list of the function
+	bool   cacheable;	// Flag of wether the result only depends on the parameters, so replies can be cached
 
 	// Public constructors
-	Function(str n, Return r, Funct f, Params p) : name(n), result(r), funct(f), params(p) {}
+	Function(str n, Return r, Funct f, Params p, bool c = false) : name(n), result(r), funct(f), params(p), cacheable(c) {}
 };
 
 //Creates a Function Object
+//A cacheable function must be pure: the service answers repeated calls
+//with the same parameters from its cache without running the function
 template <class Return, class Funct, class Params>
-static auto MakeFunction(str n, Return r, Funct f, Params p)
+static auto MakeFunction(str n, Return r, Funct f, Params p, bool cacheable = false)
 {
-	return Function<Return, Funct, Params>(n, r, f, p);
+	return Function<Return, Funct, Params>(n, r, f, p, cacheable);
 }
 
 #endif
\ No newline at end of file
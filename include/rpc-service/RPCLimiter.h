@@ -0,0 +1,46 @@
+#ifndef RPCLIMITER_H
+#define RPCLIMITER_H
+
+#include "RPCStats.h"
+
+#include <atomic>
+#include <cstddef>
+
+// Factor the adaptive limit is multiplied by when calls are slower than the target
+#define LIMIT_BACKOFF 0.9
+
+// Largest adaptive limit of a service without a fixed limit
+#define LIMIT_CEILING 1024
+
+
+// Bound on the number of requests admitted at once
+// A request is admitted if fewer requests than the limit are in flight, and
+// rejected straight away otherwise, so an overloaded server answers quickly
+// instead of queueing work it can't complete in time.
+// An adaptive limiter also follows the latency of the requests it admits,
+// like TCP's congestion window: the limit drops by LIMIT_BACKOFF when a
+// request took longer than the target, at most once per target latency, and
+// grows by one per limit's worth of faster requests while it's in use.
+// Admitting and releasing a request takes no lock.
+class RPCLimiter
+{
+public:
+	std::atomic<size_t> inflight;			// Number of requests admitted and not released
+	std::atomic<double> limit;				// Number of requests admitted at once
+	std::atomic<RPCClock::rep> lowered;		// Time the limit was last lowered
+	std::atomic<unsigned long long> rejected;	// Number of requests rejected
+	size_t floor;							// Smallest limit of the adaptive limiter
+	size_t ceiling;							// Largest limit
+	RPCClock::duration target;				// Latency past which the limit drops, 0 to keep it fixed
+
+	// Public constructors
+	RPCLimiter(size_t _ceiling, RPCClock::duration _target = RPCClock::duration::zero(), size_t _floor = 1);
+
+	// Public methods
+	bool   Acquire();
+	void   Release(RPCClock::duration latency);
+	void   Cancel();
+	size_t Limit();
+};
+
+#endif
@@ -0,0 +1,656 @@
+#ifndef RPCMARSHALL_H
+#define RPCMARSHALL_H
+
+#include "mp_types.h"
+#include "XBuffer.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstring>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+typedef std::string   str;
+typedef const char*   cstr;
+typedef unsigned char byte;
+typedef unsigned int  uint;
+
+// Flag of wether the host's byte order differs from the wire's
+// Numbers are sent little-endian, and swapped on big-endian hosts
+#define RPC_SWAP (std::endian::native != std::endian::little)
+
+// Types sent as a copy of their bytes
+// Any trivially copyable type is sent as is, without overloading Marshall and
+// Unmarshall. Specialize as false for a type with its own overloads.
+// Numbers are sent little-endian, but other types keep the host's layout, so
+// both sides need the same one. Standard containers are never raw, and
+// neither are views, which hold a pointer to memory of the sender.
+template<class T>
+struct RPCRaw : std::bool_constant<std::is_trivially_copyable_v<T> && !std::is_pointer_v<T> && !std::is_array_v<T> > {};
+
+template<class C, class T>
+struct RPCRaw<std::basic_string_view<C, T> > : std::false_type {};
+
+template<class T, size_t N>
+struct RPCRaw<std::span<T, N> > : std::false_type {};
+
+template<class T, size_t N>
+struct RPCRaw<std::array<T, N> > : std::false_type {};
+
+template<class F, class S>
+struct RPCRaw<std::pair<F, S> > : std::false_type {};
+
+template<class T>
+struct RPCRaw<std::optional<T> > : std::false_type {};
+
+template<class... Types>
+struct RPCRaw<std::tuple<Types...> > : std::false_type {};
+
+// Type a raw value is sent as
+// Types whose size depends on the platform are sent at a fixed width: long is
+// 4 bytes on LLP64 and 8 on LP64, so it is always sent as 8 bytes
+template<class T>
+struct RPCWire { typedef T type; };
+
+template<>
+struct RPCWire<long> { typedef long long type; };
+
+template<>
+struct RPCWire<unsigned long> { typedef unsigned long long type; };
+
+template<>
+struct RPCWire<wchar_t> { typedef char32_t type; };
+
+// Numbers with their bytes swapped on big-endian hosts
+template<class T>
+struct RPCNumber : std::bool_constant<(std::is_arithmetic_v<T> || std::is_enum_v<T>) && (sizeof(T) > 1)> {};
+
+// Containers sent in the compact encoding, which carries their sizes, even
+// when the rest of the call uses the raw encoding
+template<class T>
+struct RPCEncoded : std::false_type {};
+
+template<class T, class A>
+struct RPCEncoded<std::vector<T, A> > : std::true_type {};
+
+template<class K, class V, class C, class A>
+struct RPCEncoded<std::map<K, V, C, A> > : std::true_type {};
+
+template<class T, size_t N>
+struct RPCEncoded<std::array<T, N> > : std::true_type {};
+
+template<class F, class S>
+struct RPCEncoded<std::pair<F, S> > : std::true_type {};
+
+template<class T>
+struct RPCEncoded<std::optional<T> > : std::true_type {};
+
+// Layout of a list of values in a package
+// Values are packed one after the other without padding. The offsets and the
+// size are known at compile time when every value is raw.
+template<class... Types>
+struct RPCLayout
+{
+	static constexpr bool   raw  = (RPCRaw<Types>::value && ...);	// Flag of wether every value is raw
+	static constexpr size_t size = ((RPCRaw<Types>::value ? sizeof(typename RPCWire<Types>::type) : 0) + ... + 0);	// Bytes of the raw values
+
+	// Returns the position of each value in the package
+	static constexpr std::array<size_t, sizeof...(Types)> Offsets()
+	{	std::array<size_t, sizeof...(Types)> offsets{};
+		size_t sizes[] = { sizeof(typename RPCWire<Types>::type)..., 0 };
+		size_t offset  = 0;
+
+		for (size_t i = 0; i < sizeof...(Types); i++)
+		{	offsets[i] = offset;
+			offset += sizes[i];
+		}
+		return offsets;
+	}
+
+	static constexpr std::array<size_t, sizeof...(Types)> offsets = Offsets();	// Position of each value
+};
+
+// Reverses the bytes of a number
+template<class T>
+static T ByteSwap(T value)
+{	auto bytes = std::bit_cast<std::array<char, sizeof(T)> >(value);
+	std::reverse(bytes.begin(), bytes.end());
+	return std::bit_cast<T>(bytes);
+}
+
+// Reverses the bytes of each of count numbers of width bytes in place
+void SwapBytes(char* data, const size_t count, const size_t width);
+
+// Copies a raw value into the memory as it is sent
+template<class T>
+static void Put(char* memory, const T& value)
+{	typedef typename RPCWire<T>::type Wire;
+	Wire wire = (Wire)value;
+
+	if constexpr (RPC_SWAP && RPCNumber<Wire>::value)
+	{	wire = ByteSwap(wire);
+	}
+	std::memcpy(memory, &wire, sizeof(Wire));
+}
+
+// Copies raw values to their offsets in the memory
+template<class... Types, size_t... Is>
+static void Store(char* memory, std::index_sequence<Is...>, const Types&... values)
+{	(Put(memory + RPCLayout<Types...>::offsets[Is], values), ...);
+}
+
+// Copies a raw value out of the memory, which doesn't need to be aligned
+template<class T>
+static T Load(cstr memory)
+{	typedef typename RPCWire<T>::type Wire;
+	std::array<char, sizeof(Wire)> bytes;
+	std::memcpy(bytes.data(), memory, sizeof(Wire));
+	Wire wire = std::bit_cast<Wire>(bytes);
+
+	if constexpr (RPC_SWAP && RPCNumber<Wire>::value)
+	{	wire = ByteSwap(wire);
+	}
+	return (T)wire;
+}
+
+// Copies raw values out of their offsets in the memory
+// The memory isn't read when there are no values
+template<class... Types, size_t... Is>
+static std::tuple<Types...> Load([[maybe_unused]] cstr memory, std::index_sequence<Is...>)
+{	return std::tuple<Types...>{ Load<Types>(memory + RPCLayout<Types...>::offsets[Is])... };
+}
+
+
+// Breaks down data types into Byte arrays
+// Byte arrays can be sent through the network
+str Marshall(cstr raw);
+str Marshall(str  raw);
+str Marshall(std::string_view raw);
+
+template<class T> requires RPCRaw<T>::value
+str Marshall(const T& raw)
+{	char memory[sizeof(typename RPCWire<T>::type)];
+	Put(memory, raw);
+	return str(memory, sizeof(memory));
+}
+
+template<class... Types>
+str Marshall(const std::tuple<Types...>& raw);
+
+template<class T> requires RPCEncoded<T>::value
+str Marshall(const T& value);
+
+// Casts data from Byte arrays into the specified data type
+// Assigns the number of bytes consumed in size if pointer is not null
+template<class T> requires RPCRaw<T>::value
+T Unmarshall(cstr data, int* size, Type<T>)
+{	if (size != NULL)
+	{	*size = (int)sizeof(typename RPCWire<T>::type);
+	}
+	return Load<T>(data);
+}
+
+
+// Smallest buffer taken from the pool for a package
+#define PACKAGE_SIZE 64
+
+// Appends a parameter to a package
+// Strings are their own marshalled form, so they're appended without a copy
+template <class Type>
+static void Append(str& package, const Type& data)
+{	if constexpr (RPCRaw<Type>::value)
+	{	char memory[sizeof(typename RPCWire<Type>::type)];
+		Put(memory, data);
+		package.append(memory, sizeof(memory));
+	}
+	else if constexpr (std::is_same_v<Type, str>)
+	{	Buffers().Grow(package, package.size() + data.size());
+		package += data;
+	}
+	else
+	{	package += Marshall(data);
+	}
+}
+
+// Packages information from parameters into a Byte array.
+// The parameters are marshalled one after the other into a pooled buffer.
+// Raw parameters are laid out at compile time and copied in with one append.
+template<class... Args>
+static str Package(const Args&... variadic)
+{	if constexpr (RPCLayout<Args...>::raw && sizeof...(Args) > 0)
+	{	char raw[RPCLayout<Args...>::size];
+		Store(raw, std::index_sequence_for<Args...>(), variadic...);
+
+		str package = Buffers().Acquire(std::max<size_t>(PACKAGE_SIZE, sizeof(raw)));
+		package.append(raw, sizeof(raw));
+		return package;
+	}
+	else
+	{	str package = Buffers().Acquire(PACKAGE_SIZE);
+		(Append(package, variadic), ...);
+		return package;
+	}
+}
+
+// Marshalls the values of a tuple one after the other
+template<class... Types>
+str Marshall(const std::tuple<Types...>& raw)
+{	if constexpr (RPCLayout<Types...>::raw && sizeof...(Types) > 0)
+	{	char memory[RPCLayout<Types...>::size];
+		std::apply([&memory](const Types&... values)
+		{	Store(memory, std::index_sequence_for<Types...>(), values...);
+		}, raw);
+
+		return str(memory, sizeof(memory));
+	}
+	else
+	{	str package;
+		std::apply([&package](const Types&... values)
+		{	(Append(package, values), ...);
+		}, raw);
+
+		return package;
+	}
+}
+
+
+// Integers wider than a byte and enums, sent as varints in the compact encoding
+// Signed integers are zigzagged first, so small negative numbers stay short
+template<class T>
+struct RPCVarint : std::bool_constant<(std::is_integral_v<T> && sizeof(T) > 1) || std::is_enum_v<T> > {};
+
+// Types sent as a copy of their bytes in the compact encoding
+// Containers of them are copied in bulk
+template<class T>
+struct RPCFixed : std::bool_constant<RPCRaw<T>::value && !RPCVarint<T>::value> {};
+
+
+// Reads values of the compact encoding out of a payload
+// Reading past the end fails the reader and yields empty values instead, so a
+// malformed payload is never read out of bounds
+struct RPCReader
+{
+	cstr cursor;				// Position of the next value
+	cstr end;					// End of the payload
+	bool ok;					// Flag of wether every value read was complete
+
+	// Public constructors
+	RPCReader(std::string_view data) : cursor(data.data()), end(data.data() + data.size()), ok(true) {}
+
+	// Public methods
+	cstr   Take(const size_t size);
+	size_t Count();
+	unsigned long long Varint();
+};
+
+// Types with an Unmarshall overload taking a view of the bytes left in the
+// payload, which is preferred to the one taking a pointer. The view bounds
+// what the overload reads, and the decode fails if it reports a size past it.
+// The size is never NULL for such an overload.
+template<class T>
+concept RPCBounded = requires(std::string_view data, int* size)
+{	{ Unmarshall(data, size, Type<T>()) } -> std::same_as<T>;
+};
+
+// Appends an unsigned integer in groups of 7 bits, lowest first
+void WriteVarint(str& out, unsigned long long value);
+
+// Maps signed integers to unsigned ones alternating from zero: 0, -1, 1, -2...
+inline unsigned long long Zigzag(long long value)
+{	return ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63);
+}
+
+inline long long Unzigzag(unsigned long long value)
+{	return (long long)(value >> 1) ^ -(long long)(value & 1);
+}
+
+
+// Appends a value to a payload in the compact encoding
+// Strings and byte blobs are prefixed with their length, containers with
+// their number of items, and optionals with a byte of wether they hold a value
+// Other types are marshalled and prefixed with their length
+void Encode(str& out, cstr value);
+void Encode(str& out, const str& value);
+void Encode(str& out, std::string_view value);
+
+template<class T> void Encode(str& out, const T& value);
+template<class T, class A> void Encode(str& out, const std::vector<T, A>& values);
+template<class T, size_t N> void Encode(str& out, const std::array<T, N>& values);
+template<class K, class V, class C, class A> void Encode(str& out, const std::map<K, V, C, A>& values);
+template<class F, class S> void Encode(str& out, const std::pair<F, S>& value);
+template<class T> void Encode(str& out, const std::optional<T>& value);
+template<class... Types> void Encode(str& out, const std::tuple<Types...>& values);
+
+// Reads a value of the compact encoding
+// Strings views point into the payload and are only valid as long as it is
+str Decode(RPCReader& reader, Type<str>);
+std::string_view Decode(RPCReader& reader, Type<std::string_view>);
+
+template<class T> T Decode(RPCReader& reader, Type<T>);
+template<class T, class A> std::vector<T, A> Decode(RPCReader& reader, Type<std::vector<T, A> >);
+template<class T, size_t N> std::array<T, N> Decode(RPCReader& reader, Type<std::array<T, N> >);
+template<class K, class V, class C, class A> std::map<K, V, C, A> Decode(RPCReader& reader, Type<std::map<K, V, C, A> >);
+template<class F, class S> std::pair<F, S> Decode(RPCReader& reader, Type<std::pair<F, S> >);
+template<class T> std::optional<T> Decode(RPCReader& reader, Type<std::optional<T> >);
+template<class... Types> std::tuple<Types...> Decode(RPCReader& reader, Type<std::tuple<Types...> >);
+
+
+template<class T>
+void Encode(str& out, const T& value)
+{
+	if constexpr (std::is_enum_v<T>)
+	{	Encode(out, (std::underlying_type_t<T>)value);
+	}
+	else if constexpr (RPCVarint<T>::value && std::is_signed_v<T>)
+	{	WriteVarint(out, Zigzag((long long)value));
+	}
+	else if constexpr (RPCVarint<T>::value)
+	{	WriteVarint(out, (unsigned long long)value);
+	}
+	else if constexpr (RPCFixed<T>::value)
+	{	char memory[sizeof(T)];
+		Put(memory, value);
+		out.append(memory, sizeof(T));
+	}
+	else
+	{	str bytes = Marshall(value);
+		WriteVarint(out, bytes.size());
+		out += bytes;
+	}
+}
+
+// Vectors of fixed types are copied in one go after their count
+template<class T, class A>
+void Encode(str& out, const std::vector<T, A>& values)
+{
+	WriteVarint(out, values.size());
+
+	if constexpr (RPCFixed<T>::value && !std::is_same_v<T, bool>)
+	{	size_t at = out.size();
+		Buffers().Grow(out, at + values.size() * sizeof(T));
+		out.append((cstr)values.data(), values.size() * sizeof(T));
+
+		if constexpr (RPC_SWAP && RPCNumber<T>::value)
+		{	SwapBytes(&out[at], values.size(), sizeof(T));
+		}
+	}
+	else
+	{	for (const T& value : values)
+		{	Encode(out, value);
+		}
+	}
+}
+
+// Arrays have a known number of items and are sent without a count
+template<class T, size_t N>
+void Encode(str& out, const std::array<T, N>& values)
+{
+	if constexpr (RPCFixed<T>::value)
+	{	size_t at = out.size();
+		out.append((cstr)values.data(), N * sizeof(T));
+
+		if constexpr (RPC_SWAP && RPCNumber<T>::value)
+		{	SwapBytes(&out[at], N, sizeof(T));
+		}
+	}
+	else
+	{	for (const T& value : values)
+		{	Encode(out, value);
+		}
+	}
+}
+
+template<class K, class V, class C, class A>
+void Encode(str& out, const std::map<K, V, C, A>& values)
+{
+	WriteVarint(out, values.size());
+	for (const auto& value : values)
+	{	Encode(out, value.first);
+		Encode(out, value.second);
+	}
+}
+
+template<class F, class S>
+void Encode(str& out, const std::pair<F, S>& value)
+{	Encode(out, value.first);
+	Encode(out, value.second);
+}
+
+template<class T>
+void Encode(str& out, const std::optional<T>& value)
+{	out.push_back(value.has_value() ? 1 : 0);
+	if (value.has_value())
+	{	Encode(out, *value);
+	}
+}
+
+template<class... Types>
+void Encode(str& out, const std::tuple<Types...>& values)
+{	std::apply([&out](const Types&... value)
+	{	(Encode(out, value), ...);
+	}, values);
+}
+
+
+template<class T>
+T Decode(RPCReader& reader, Type<T>)
+{
+	if constexpr (std::is_enum_v<T>)
+	{	return (T)Decode(reader, Type<std::underlying_type_t<T> >());
+	}
+	else if constexpr (RPCVarint<T>::value && std::is_signed_v<T>)
+	{	return (T)Unzigzag(reader.Varint());
+	}
+	else if constexpr (RPCVarint<T>::value)
+	{	return (T)reader.Varint();
+	}
+	else if constexpr (RPCFixed<T>::value)
+	{	cstr bytes = reader.Take(sizeof(T));
+		return bytes != NULL ? Load<T>(bytes) : std::bit_cast<T>(std::array<char, sizeof(T)>{});
+	}
+	else if constexpr (RPCBounded<T>)
+	{	size_t size  = reader.Count();
+		cstr   bytes = reader.Take(size);
+		int    used  = 0;
+
+		T value = Unmarshall(bytes != NULL ? std::string_view(bytes, size) : std::string_view(), &used, Type<T>());
+		reader.ok = reader.ok && used >= 0 && (size_t)used <= size;
+		return value;
+	}
+	else
+	{	// A value cut short is unmarshalled from zeros
+		static const char zeros[PACKAGE_SIZE] = {};
+		size_t size  = reader.Count();
+		cstr   bytes = reader.Take(size);
+		return Unmarshall(bytes != NULL ? bytes : zeros, NULL, Type<T>());
+	}
+}
+
+// Vectors of fixed types are copied in one go after their count
+template<class T, class A>
+std::vector<T, A> Decode(RPCReader& reader, Type<std::vector<T, A> >)
+{
+	std::vector<T, A> values;
+	size_t count = reader.Count();
+
+	if constexpr (RPCFixed<T>::value && !std::is_same_v<T, bool> && std::is_default_constructible_v<T>)
+	{	cstr bytes = reader.Take(count * sizeof(T));
+		if (bytes != NULL)
+		{	values.resize(count);
+			std::memcpy(values.data(), bytes, count * sizeof(T));
+
+			if constexpr (RPC_SWAP && RPCNumber<T>::value)
+			{	SwapBytes((char*)values.data(), count, sizeof(T));
+			}
+		}
+	}
+	else
+	{	values.reserve(count);
+		for (size_t i = 0; i < count && reader.ok; i++)
+		{	values.push_back(Decode(reader, Type<T>()));
+		}
+	}
+	return values;
+}
+
+// Reads the items of an array in order
+template<class T, size_t... Is>
+static std::array<T, sizeof...(Is)> DecodeArray(RPCReader& reader, std::index_sequence<Is...>)
+{	return std::array<T, sizeof...(Is)>{ ((void)Is, Decode(reader, Type<T>()))... };
+}
+
+template<class T, size_t N>
+std::array<T, N> Decode(RPCReader& reader, Type<std::array<T, N> >)
+{
+	if constexpr (RPCFixed<T>::value)
+	{	std::array<char, N * sizeof(T)> bytes{};
+		cstr taken = reader.Take(N * sizeof(T));
+
+		if (taken != NULL)
+		{	std::memcpy(bytes.data(), taken, N * sizeof(T));
+		}
+
+		auto values = std::bit_cast<std::array<T, N> >(bytes);
+		if constexpr (RPC_SWAP && RPCNumber<T>::value)
+		{	SwapBytes((char*)values.data(), N, sizeof(T));
+		}
+		return values;
+	}
+	else
+	{	return DecodeArray<T>(reader, std::make_index_sequence<N>());
+	}
+}
+
+template<class K, class V, class C, class A>
+std::map<K, V, C, A> Decode(RPCReader& reader, Type<std::map<K, V, C, A> >)
+{
+	std::map<K, V, C, A> values;
+	size_t count = reader.Count();
+
+	for (size_t i = 0; i < count && reader.ok; i++)
+	{	K key   = Decode(reader, Type<K>());
+		V value = Decode(reader, Type<V>());
+		values.emplace(std::move(key), std::move(value));
+	}
+	return values;
+}
+
+template<class F, class S>
+std::pair<F, S> Decode(RPCReader& reader, Type<std::pair<F, S> >)
+{	return std::pair<F, S>{ Decode(reader, Type<F>()), Decode(reader, Type<S>()) };
+}
+
+template<class T>
+std::optional<T> Decode(RPCReader& reader, Type<std::optional<T> >)
+{	cstr flag = reader.Take(1);
+	if (flag == NULL || *flag == 0)
+	{	return std::nullopt;
+	}
+	return Decode(reader, Type<T>());
+}
+
+template<class... Types>
+std::tuple<Types...> Decode(RPCReader& reader, Type<std::tuple<Types...> >)
+{	return std::tuple<Types...>{ Decode(reader, Type<Types>())... };
+}
+
+
+// Marshalls a container in the compact encoding
+template<class T> requires RPCEncoded<T>::value
+str Marshall(const T& value)
+{	str out;
+	Encode(out, value);
+	return out;
+}
+
+
+// Reads a value of the raw encoding out of a payload
+// Raw values are copied out, strings take the rest of the payload, and
+// containers are read in the compact encoding. Other types are unmarshalled by
+// their own overloads, given the rest of the payload if they take a view.
+// Overloads taking a pointer aren't bounded, and are given zeros if the
+// payload is used up.
+str Unmarshall(RPCReader& reader, Type<str>);
+std::string_view Unmarshall(RPCReader& reader, Type<std::string_view>);
+
+template<class... Types>
+std::tuple<Types...> Unmarshall(RPCReader& reader, Type<std::tuple<Types...> >);
+
+template<class T>
+T Unmarshall(RPCReader& reader, Type<T> type)
+{
+	if constexpr (RPCRaw<T>::value)
+	{	cstr bytes = reader.Take(sizeof(typename RPCWire<T>::type));
+		return bytes != NULL ? Load<T>(bytes) : std::bit_cast<T>(std::array<char, sizeof(T)>{});
+	}
+	else if constexpr (RPCEncoded<T>::value)
+	{	return Decode(reader, type);
+	}
+	else if constexpr (RPCBounded<T>)
+	{	int size = 0;
+		T value = Unmarshall(std::string_view(reader.cursor, reader.end - reader.cursor), &size, type);
+
+		if (size < 0 || reader.Take(size) == NULL)
+		{	reader.ok = false;
+		}
+		return value;
+	}
+	else
+	{	static const char zeros[PACKAGE_SIZE] = {};
+		int size = 0;
+
+		if (reader.cursor == reader.end)
+		{	reader.ok = false;
+			return Unmarshall(zeros, NULL, type);
+		}
+
+		T value = Unmarshall(reader.cursor, &size, type);
+		reader.Take(size);
+		return value;
+	}
+}
+
+// Tuples of raw values are copied out of offsets known at compile time
+template<class... Types>
+std::tuple<Types...> Unmarshall(RPCReader& reader, Type<std::tuple<Types...> >)
+{
+	if constexpr (RPCLayout<Types...>::raw)
+	{	static const char zeros[RPCLayout<Types...>::size + 1] = {};
+		cstr bytes = reader.Take(RPCLayout<Types...>::size);
+		return Load<Types...>(bytes != NULL ? bytes : zeros, std::index_sequence_for<Types...>());
+	}
+	else
+	{	return std::tuple<Types...>{ Unmarshall(reader, Type<Types>())... };
+	}
+}
+
+
+// Packages information from parameters into a Byte array.
+// The parameters are encoded one after the other in the compact encoding
+template<class... Args>
+static str Compact(const Args&... variadic)
+{	str package = Buffers().Acquire(PACKAGE_SIZE);
+	(Encode(package, variadic), ...);
+	return package;
+}
+
+// Reads the result of a call in the compact or the raw encoding
+// Returns false if the result is cut short
+template<class Return>
+static bool Extract(std::string_view data, const bool compact, Return& value)
+{
+	RPCReader reader(data);
+	value = compact ? Decode(reader, Type<Return>()) : Unmarshall(reader, Type<Return>());
+	return reader.ok;
+}
+
+#endif
@@ -3,17 +3,40 @@
 
 #include "mp_types.h"
 #include "XSocket.h"
-
+#include "XThread.h"
+#include "XBuffer.h"
+#include "XReactor.h"
+#include "RPCFrame.h"
+#include "RPCMarshall.h"
+#include "RPCStats.h"
+#include "RPCLimiter.h"
+#include "RPCCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <tuple>
+#include <unordered_map>
+#include <utility>
 
 typedef std::string   str;
 typedef const char*   cstr;
 typedef unsigned char byte;
 typedef unsigned int  uint;
 
+
+template<class List> class RPCService;
+template<class Type> unsigned long XTHREAD_CALL serverFn(void* lparameter);
+template<class Type> unsigned long XTHREAD_CALL processFn(void* lparameter);
+
+
 // Request structure consisting of an XSocket interface to a client
 // And a void* memory address to a thread fullfilling the request
 struct Request
@@ -23,9 +46,187 @@ struct Request
 };
 
 
+// Milliseconds the listener is given to end before it is terminated
+#define LISTENER_TIMEOUT 1000
+
+// Number of independently locked parts of the registry of requests
+#define REGISTRY_SHARDS 16
+
+
+// Part of the registry holding the requests whose keys fall in it
+struct RPCShard
+{
+	std::mutex lock;										// Guards the requests of the shard
+	std::unordered_map<unsigned long long, Request> entries;	// Requests by key
+};
+
+
+// Requests served on their own thread, by key
+// Connection threads add and remove themselves as they start and end, so the
+// registry only holds the live requests. Keys are spread over shards locked
+// on their own, so threads of different connections rarely wait on each other.
+// A request is removed exactly once: by its thread when it ends, or by Clear
+// when the service stops, and whoever removes it owns its socket and thread.
+class RPCRegistry
+{
+public:
+	RPCShard shards[REGISTRY_SHARDS];				// Requests spread by key
+	std::atomic<unsigned long long> nextKey;		// Key of the next request
+	std::atomic<size_t> count;						// Number of requests registered
+
+	// Public constructors
+	RPCRegistry();
+
+	// Public methods
+	unsigned long long Add(const Request& request);
+	bool   Attach(unsigned long long key, void* thread);
+	bool   Remove(unsigned long long key, Request& removed);
+	std::vector<Request> Clear();
+	void   Shutdown();
+	size_t size();
+
+	// Private methods
+	RPCShard& Shard(unsigned long long key);
+};
+
+
+struct RPCMethod;
+
+
+// Frame waiting for a worker along with the connection to reply on
+// Jobs are recycled so queueing a request doesn't allocate
+struct RPCJob
+{
+	std::shared_ptr<XPeer> peer;	// Connection the request was read from
+	Frame frame;					// Frame of the request
+	RPCClock::time_point queued;	// Time the request was queued for a worker
+	RPCMethod* method;				// Function the request calls if it was looked up, NULL otherwise
+	bool admitted;					// Flag of wether the request holds room in the limiters
+};
+
+
+// Batch whose calls run on different workers at the same time
+// The worker completing the last call sends the reply of the whole batch
+struct RPCSplit
+{
+	RPCJob* job;							// Job of the frame holding the batch
+	uint    flags;							// Flags the calls are read with
+	std::vector<std::string_view> calls;	// Calls of the batch, viewing the frame
+	std::vector<str>  replies;				// Results of the calls
+	std::vector<uint> codes;				// Flags of the results
+	std::atomic<size_t> left;				// Number of calls still running
+	RPCClock::time_point deadline;			// Time past which the calls are dropped
+};
+
+
+// Function of the service that can be called by name or by id
+// The invoker unpacks the parameters, calls the function and marshalls the result
+// in the raw or the compact encoding. It sets the time the parameters were decoded.
+struct RPCMethod
+{
+	str  name;				// Name of the function
+	uint id;				// Id of the function sent in place of its name
+	bool pinned;			// Flag of wether the function runs on the pinned pool in event mode
+	std::function<bool(str& reply, std::string_view data, bool compact, RPCClock::time_point& decoded)> invoke;	// Type-erased call of the function
+	std::shared_ptr<RPCStats> stats;	// Counters of the calls to the function
+	size_t limit;						// Largest number of calls run or waiting at once, 0 for no limit
+	std::shared_ptr<RPCLimiter> limiter;	// Limiter of the calls while the service runs, NULL without a limit
+	bool cacheable;						// Flag of wether the replies of the function are cached
+};
+
+
+// Hash of the names of the functions
+// Transparent, so names in a request are looked up as views without a copy
+struct RPCNameHash
+{
+	typedef void is_transparent;
+
+	size_t operator()(std::string_view name) const
+	{	return std::hash<std::string_view>()(name);
+	}
+};
+
+
+// Name of the function every service has, returning a snapshot of its counters
+#define STATS_METHOD "__stats"
+
+// Milliseconds RPC() waits for a reply, 0 to wait forever
+// Calls made while a function of a service runs also end with its deadline
+#ifndef RPC_TIMEOUT
+#define RPC_TIMEOUT 0
+#endif
+
+
+// Returns the deadline of a request received at the time given
+// The timeout is that of the request's header, 0 if the request has no deadline
+inline RPCClock::time_point RPCDeadline(const uint timeout, const RPCClock::time_point received)
+{	return timeout > 0 ? received + std::chrono::milliseconds(timeout) : RPCClock::time_point::max();
+}
+
+// Returns the timeout sent in the header of a request with the deadline
+// Rounded up to whole milliseconds and at least 1, or 0 for no deadline
+inline uint RPCTimeout(const RPCClock::time_point deadline)
+{
+	if (deadline == RPCClock::time_point::max())
+	{	return 0;
+	}
+
+	long long left = std::chrono::ceil<std::chrono::milliseconds>(deadline - RPCClock::now()).count();
+	return left < 1 ? 1 : left > 0xFFFFFFFFLL ? 0xFFFFFFFFu : (uint)left;
+}
+
+// Deadline of the call being run on the current thread
+// Set by the service while a function runs, the latest time otherwise
+inline RPCClock::time_point& RPCCurrentDeadline()
+{	thread_local RPCClock::time_point deadline = RPCClock::time_point::max();
+	return deadline;
+}
+
+// Returns the deadline of a call made now that waits timeout milliseconds
+// for its reply, or forever if the timeout is not positive
+// A call made while a function runs ends no later than the function's caller
+inline RPCClock::time_point RPCCallDeadline(const int timeout)
+{
+	RPCClock::time_point deadline = RPCCurrentDeadline();
+	if (timeout > 0)
+	{	deadline = std::min(deadline, RPCClock::now() + std::chrono::milliseconds(timeout));
+	}
+	return deadline;
+}
+
+// Returns the time left before the caller of the function being run gives up
+// Functions can check it to cut long work short. Returns the longest duration
+// if the caller waits forever, and zero once the deadline passed.
+inline RPCClock::duration RPCRemaining()
+{
+	RPCClock::time_point deadline = RPCCurrentDeadline();
+	if (deadline == RPCClock::time_point::max())
+	{	return RPCClock::duration::max();
+	}
+
+	RPCClock::time_point now = RPCClock::now();
+	return deadline > now ? deadline - now : RPCClock::duration::zero();
+}
+
+
 // A service with a list of functions that can be requested by the client
-// Listens to incoming requests in a separate thread, and creates a new
-// Threads for completing the requests. Active requests are stored in a vector.
+// Listens to incoming requests in a separate thread. By default it creates new
+// Threads for completing the requests. Active requests are kept in a registry.
+// In event mode, reactors multiplex the clients and a fixed pool of workers
+// completes the requests instead. Functions pinned to their own pool run apart
+// from the workers, so long calls don't hold up short ones.
+// An admission limit bounds the connection threads in thread mode, and the
+// requests waiting for a worker in event mode.
+// Limiters bound the requests run or waiting at once, by the whole service and
+// by single functions, and reject the excess straight away as overloaded. The
+// service's limit can adapt to the latency of its requests, so it sheds load
+// before the queues grow instead of slowing every request down.
+// Replies of cacheable functions are cached by their parameters' bytes, and
+// repeated calls are answered with them without running the function.
+// Requests carrying a timeout are dropped with an expired error if their
+// deadline passes before they run, and functions can read the time left.
+// Draining the service stops it gracefully: it stops accepting, lets the
+// requests in flight complete, and then closes the connections.
 // RPCService is managed by IRPCService, an interface for dealing with the service.
 template<class List>
 class RPCService
@@ -34,154 +235,854 @@ public:
 	List     RPCList;				// List of functions available in the service
 	IXSocket server;				// Interface of the socket listening for requests
 	void*    serverThr;				// Handle of the thread listening for requests
-
-	std::vector<Request> requests;	// List of requests running on the service
+	std::atomic<bool> draining;		// Flag of wether the service stopped taking new requests
+	bool     running;				// Flag of wether the service is started
+	bool     listening;				// Flag of wether the listener is accepting connections
+	std::mutex              stateLock;		// Guards the flags of the service's state
+	std::condition_variable stateSignal;	// Wakes the threads waiting for the service or the listener to stop
+	int      zeroCopy;				// Smallest reply sent without copying, 0 to copy every reply
+	size_t   backlog;				// Largest number of reply bytes queued for a client in event mode
+	size_t   frameMax;				// Largest request payload accepted, past which the client is closed
+
+	RPCRegistry requests;			// Requests running on their own thread
+	size_t   admission;				// Largest number of waiting requests or connection threads, 0 for no limit
+	int      admissionTimeout;		// Milliseconds a request waits for room before it's rejected
+	int      active;				// Number of connections served on their own thread
+	std::mutex              activeLock;		// Guards the number of connection threads
+	std::condition_variable activeSignal;	// Wakes the listener when a connection thread ends
+
+	size_t limit;					// Largest number of requests run or waiting at once, 0 for no limit
+	int    limitTarget;				// Milliseconds of latency the service's limit adapts to, 0 to keep it fixed
+	size_t limitFloor;				// Smallest limit the service's limit adapts down to
+	size_t limited;					// Number of functions with a limit of their own
+	std::unique_ptr<RPCLimiter> limiter;	// Limiter of the service's requests while it runs, NULL without a limit
+
+	size_t cacheBytes;				// Largest number of bytes of cached replies
+	int    cacheTTL;				// Milliseconds a reply is cached, 0 to keep it until evicted
+	size_t cacheable;				// Number of functions whose replies are cached
+	std::unique_ptr<RPCCache> cache;	// Replies of the cacheable functions while the service runs, NULL without any
+
+	std::vector<RPCMethod> methods;					// Functions of the service in the order listed
+	std::unordered_map<str, size_t, RPCNameHash, std::equal_to<> > names;	// Index of the functions by name
+	std::unordered_map<uint, size_t> ids;			// Index of the functions by id
+	std::vector<uint> collisions;					// Ids shared by more than one function
+
+	std::vector<XReactor*> reactors;	// Event loops serving the clients in event mode
+	XThreadPool workers;				// Threads completing the requests in event mode
+	XThreadPool pinned;					// Threads completing the requests of pinned functions
+	int         pinnedThreads;			// Number of threads of the pinned pool
+	size_t      pins;					// Number of pinned functions
+	size_t      nextReactor;			// Index of the reactor receiving the next client
+
+	std::mutex           jobLock;		// Guards the lists of jobs
+	std::vector<RPCJob*> jobs;			// Jobs free to hold a new request
+	std::vector<RPCJob*> made;			// Every job created by the service
+	std::condition_variable idleSignal;	// Wakes a drain when the last job is freed
 
 	RPCService(List functions) 
-	: RPCList(functions), serverThr(NULL) 
-	{ 
+	: RPCList(functions), serverThr(NULL), draining(false), running(false), listening(false), zeroCopy(0), backlog(REACTOR_BACKLOG), frameMax(FRAME_MAX), admission(0), admissionTimeout(0), active(0)
+	, limit(0), limitTarget(0), limitFloor(1), limited(0), cacheBytes(CACHE_BYTES), cacheTTL(0), cacheable(0)
+	, pinnedThreads(1), pins(0), nextReactor(0)
+	{	Index(std::make_index_sequence< std::tuple_size< List >::value>{});
 	}
 
 	// Stops the service if it's currently running
 	// Starts the service on the port specified
 	// Creates a thread listening to new requests
-	bool Start(int port)
+	// With I/O threads specified, the service runs in event mode with that
+	// many reactors, and a pool of worker threads (one per core if not positive)
+	bool Start(int port, int ioThreads = 0, int workerThreads = 0)
+	{
+		if (!Host(port, ioThreads, workerThreads))
+		{	return false;
+		}
+
+		serverThr = XCreateThread(serverFn<List>, this);
+		if (serverThr == NULL)
+		{	Listened();
+			Stop();
+		}
+
+		return serverThr != NULL;
+	}
+
+	// Starts the service like Start, but listens on the calling thread
+	// Returns once the service is stopped from another thread, or false if
+	// it could not start
+	bool Run(int port, int ioThreads = 0, int workerThreads = 0)
 	{
+		if (!Host(port, ioThreads, workerThreads))
+		{	return false;
+		}
+
+		serverFn<List>(this);
+		Wait();
+		return true;
+	}
+
+	// Blocks the calling thread until the service is stopped
+	void Wait()
+	{	std::unique_lock<std::mutex> guard(stateLock);
+		stateSignal.wait(guard, [this]() { return !running; });
+	}
+
+	// Stops the service if it's currently running
+	// Hosts the server socket, and starts the reactors and workers in event mode
+	// The service is then running, and only waits for a listener
+	// A service with functions whose ids collide is never hosted, as clients
+	// only call functions by id
+	bool Host(int port, int ioThreads, int workerThreads)
+	{
+		if (!collisions.empty())
+		{	return false;
+		}
+
 		Stop();
+		draining = false;
+		Limiters();
+		cache.reset(cacheable > 0 ? new RPCCache(cacheBytes, std::chrono::milliseconds(cacheTTL)) : NULL);
 		server.Host(TCP, port);
 
-		if (server.good())
-		{	serverThr = CreateThread(NULL, NULL, serverFn<List>, this, NULL, NULL);
+		if (server.good() && ioThreads > 0)
+		{	workers.Start(workerThreads, admission);
+			if (pins > 0)
+			{	pinned.Start(pinnedThreads, admission);
+			}
+
+			for (int i = 0; i < ioThreads; i++)
+			{	XReactor* reactor = new XReactor();
+				reactor->backlog = backlog;
+				reactors.push_back(reactor);
+
+				if (!reactor->Start([this](std::shared_ptr<XPeer> peer, std::vector<Frame>& frames) { Dispatch(peer, frames); }))
+				{	Stop();
+					return false;
+				}
+			}
 		}
 
-		return serverThr != NULL;
+		if (!server.good())
+		{	Stop();
+			return false;
+		}
+
+		std::lock_guard<std::mutex> guard(stateLock);
+		running   = true;
+		listening = true;
+		return true;
+	}
+
+	// Marks the listener as ended, called by the listener as it returns
+	void Listened()
+	{
+		{	std::lock_guard<std::mutex> guard(stateLock);
+			listening = false;
+		}
+		stateSignal.notify_all();
 	}
 	 
-	// Closes the server socket, and deallocates all client sockets 
-	// Terminates all running threads and clears requests
-	void Stop()
+	// Stops taking new requests and waits up to timeout milliseconds for the
+	// requests in flight to complete, then stops the service
+	// Connections waiting for their next request are closed right away in
+	// thread mode. In event mode, requests read while draining are rejected
+	// with an error. Returns false if some requests were still running at
+	// the deadline: their connections are shut down, and their threads and
+	// the workers are still joined once their current call completes.
+	// Requests still queued for a worker at the deadline are dropped unrun.
+	bool Drain(int timeout)
 	{
-		server.Close();
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+		bool drained  = true;
+
+		draining = true;
+		Quiet();
+		requests.Shutdown();
+
+		{	std::unique_lock<std::mutex> guard(activeLock);
+			drained = activeSignal.wait_until(guard, deadline, [this]() { return active == 0; });
+		}
+
+		{	std::unique_lock<std::mutex> guard(jobLock);
+			drained = idleSignal.wait_until(guard, deadline, [this]() { return jobs.size() == made.size(); }) && drained;
+		}
+
+		// Replies still queued for slow peers are written before the connections close
+		for (size_t i = 0; i < reactors.size(); i++)
+		{	drained = reactors[i]->Flush(deadline) && drained;
+		}
+
+		Stop();
+		return drained;
+	}
+
+	// Stops the listener and waits for it to end, on its thread or the one running the service
+	// The listener's thread is only terminated if it doesn't end in time
+	void Quiet()
+	{
+		draining = true;
+		server.Shutdown();
+
+		{	std::unique_lock<std::mutex> guard(stateLock);
+			stateSignal.wait_for(guard, std::chrono::milliseconds(LISTENER_TIMEOUT), [this]() { return !listening; });
+		}
+
 		if (serverThr != NULL)
-		{	TerminateThread(serverThr, 0);
+		{	XWaitThread(serverThr, LISTENER_TIMEOUT);
+			XTerminateThread(serverThr);
 			serverThr = NULL;
 		}
 
-		for (int i = 0; i < requests.size(); i++)
-		{	if (requests[i].thread != NULL)
-			{	TerminateThread(requests[i].thread, 0);
-				requests[i].client.Delete();
+		server.Close();
+	}
+
+	// Closes the server socket, and deallocates all client sockets 
+	// Shuts the connections down and waits for their threads to return from
+	// the call they're running, then clears requests
+	// Use Drain to let the requests in flight complete first
+	void Stop()
+	{
+		Quiet();
+
+		// Requests taken out of the registry are no longer removed by their
+		// threads, which still use their socket until they return. Stopping
+		// the sends as well wakes the threads blocked writing a reply.
+		std::vector<Request> remaining = requests.Clear();
+		for (size_t i = 0; i < remaining.size(); i++)
+		{	remaining[i].client.Shutdown(true);
+		}
+
+		for (size_t i = 0; i < remaining.size(); i++)
+		{	if (remaining[i].thread != NULL)
+			{	XWaitThread(remaining[i].thread, -1);
+				XReleaseThread(remaining[i].thread);
 			}
+			remaining[i].client.Delete();
+		}
+
+		// Threads that removed their request themselves are only left to count
+		// their end, after which they no longer touch the service
+		{	std::unique_lock<std::mutex> guard(activeLock);
+			activeSignal.wait(guard, [this]() { return active == 0; });
+		}
+
+		for (size_t i = 0; i < reactors.size(); i++)
+		{	reactors[i]->Stop();
+		}
+
+		workers.Stop();
+		pinned.Stop();
+
+		for (size_t i = 0; i < reactors.size(); i++)
+		{	delete reactors[i];
+		}
+
+		reactors.clear();
+
+		// Jobs of requests dropped by the workers are freed as well
+		std::lock_guard<std::mutex> guard(jobLock);
+		for (size_t i = 0; i < made.size(); i++)
+		{	delete made[i];
 		}
 
-		requests.clear();
+		jobs.clear();
+		made.clear();
+
+		{	std::lock_guard<std::mutex> state(stateLock);
+			running = false;
+		}
+		stateSignal.notify_all();
+	}
+
+	// Hands a new client to one of the reactors in turn
+	void Attach(IXSocket client)
+	{	reactors[nextReactor++ % reactors.size()]->Add(client, frameMax);
 	}
 
+	// Queues every frame read by a reactor for the worker threads, or for the
+	// pinned pool if it calls a pinned function
+	// Requests on the same connection run concurrently and may complete out
+	// of order, the replies carry the id of their request
+	// Requests past the limiters are rejected straight away as overloaded.
+	// A request finding the queues full waits for room up to the admission
+	// timeout, holding up the reactor, and is then rejected as overloaded too
+	void Dispatch(std::shared_ptr<XPeer> peer, std::vector<Frame>& frames)
+	{
+		for (size_t i = 0; i < frames.size(); i++)
+		{	RPCJob* job = Job();
+			job->peer  = peer;
+			job->frame = std::move(frames[i]);
+			job->queued = RPCClock::now();
+			job->method = pins > 0 || limited > 0 ? Method(job->frame.header.flags, job->frame.payload) : NULL;
+			peer->inflight++;
+
+			if (draining)
+			{	Reply(job, FRAME_ERROR, str());
+				Free(job);
+				continue;
+			}
 
-	// Starts the process of executing the requested service
-	// Creates an index sequence to start cycling through services
-	bool Parse(IXSocket client, str name, str data)
-	{	auto iSeq = std::make_index_sequence< std::tuple_size< List >::value>{};
-		return Cycle(client, name, data, iSeq);
+			if (!Enter(job->method))
+			{	Overloaded(job);
+				continue;
+			}
+
+			// The task only holds pointers, so it fits in the function object
+			// A full queue means the service admits too much, and counts as slow
+			XThreadPool& pool = job->method != NULL && job->method->pinned ? pinned : workers;
+			job->admitted = true;
+
+			if (!pool.Post([this, job]() { Complete(job); }, admissionTimeout))
+			{	Exit(job->method, RPCClock::duration::max());
+				job->admitted = false;
+				Overloaded(job);
+			}
+		}
 	}
 
-	// Starts cycling through the services with the indexes
-	template<size_t... Is>
-	bool Cycle(IXSocket client, str name, str data, std::index_sequence<Is...>)
-	{	return Evaluate(client, name, data, std::get<Is>(RPCList)...);
+	// Rejects the request of a job as overloaded and frees the job
+	void Overloaded(RPCJob* job)
+	{
+		if (job->method != NULL)
+		{	job->method->stats->Reject(job->frame.payload.size());
+		}
+
+		Reply(job, FRAME_ERROR | FRAME_OVERLOADED, str());
+		Free(job);
 	}
 
-	// Evaluates the request by comparing it with the list of available services
-	template<class Proc, class... Args>
-	bool Evaluate(IXSocket client, str name, str data, Proc function, Args... args)
+	// Returns the function called by the request in the payload of a frame
+	// Returns NULL for batches, and for functions the service doesn't have
+	RPCMethod* Method(const uint flags, std::string_view request)
 	{
-		if (function.name == name)
-		{	return Prepare(client, function.result, function.funct, function.params, data);
+		if ((flags & FRAME_BATCH) != 0)
+		{	return NULL;
 		}
-		else 
-		{	return Evaluate(client, name, data, args...); 
+
+		if ((flags & FRAME_METHOD) != 0)
+		{	return request.size() >= METHOD_SIZE ? Find(ReadMethod(request.data())) : NULL;
 		}
+
+		return Find(request.substr(0, request.find('\n')));
 	}
 
-	// Finishes evaluating the request with the last service available
-	template<class Proc>
-	bool Evaluate(IXSocket client, str name, str data, Proc function)
+	// Creates the limiters of the service and of its functions with their
+	// settings, while the service is stopped
+	void Limiters()
 	{
-		if (function.name == name)
-		{	return Prepare(client, function.result, function.funct, function.params, data);
+		limiter.reset();
+		if (limit > 0 || limitTarget > 0)
+		{	limiter.reset(new RPCLimiter(limit > 0 ? limit : LIMIT_CEILING, std::chrono::milliseconds(limitTarget), limitFloor));
+		}
+
+		limited = 0;
+		for (size_t i = 0; i < methods.size(); i++)
+		{	methods[i].limiter = methods[i].limit > 0 ? std::make_shared<RPCLimiter>(methods[i].limit) : NULL;
+			limited += methods[i].limit > 0 ? 1 : 0;
 		}
-		else 
+	}
+
+	// Bounds the calls to the function run or waiting at once, 0 for no limit
+	// Returns false if the service has no function with the name
+	bool Limit(const str& name, size_t calls)
+	{
+		RPCMethod* method = Find(name);
+		if (method == NULL)
 		{	return false;
-			console("<Server> ", name, " is not an RPC function!\n"); 
-			client.Delete();
 		}
+
+		method->limit = calls;
+		return true;
 	}
 
-	// Prepares the execution of the function with parameters
-	// Creates an index sequence to start cycling through parameters
-	template<class Return, class Proc, class Types>
-	bool Prepare(IXSocket client, Return result, Proc funct, Types types, str data)
-	{	auto iSeq = std::make_index_sequence< std::tuple_size< Types >::value>{};
-		return Sequence(client, result, funct, types, data, iSeq);
+	// Admits a request to the function into the limiters of the service and
+	// of the function, which is NULL if it wasn't looked up
+	// Returns false if either one is full, in which case neither is held
+	bool Enter(RPCMethod* method)
+	{
+		if (limiter != NULL && !limiter->Acquire())
+		{	return false;
+		}
+
+		if (method != NULL && method->limiter != NULL && !method->limiter->Acquire())
+		{	if (limiter != NULL)
+			{	limiter->Cancel();
+			}
+			return false;
+		}
+
+		return true;
+	}
+
+	// Releases a request admitted by Enter along with the time it took
+	void Exit(RPCMethod* method, RPCClock::duration latency)
+	{
+		if (limiter != NULL)
+		{	limiter->Release(latency);
+		}
+		if (method != NULL && method->limiter != NULL)
+		{	method->limiter->Release(latency);
+		}
 	}
 
-	// Starts going through the parameters supplied
-	template<class Return, class Proc, class Types, size_t... Is>
-	bool Sequence(IXSocket client, Return result, Proc funct, Types types, str data, std::index_sequence<Is...>)
-	{	int index = 0;
-		return Unpack(client, result, funct, data, index, std::tuple<>(), std::get<Is>(types)...);
+	// Returns the number of requests the service admits at once, 0 for no limit
+	size_t Capacity()
+	{	return limiter != NULL ? limiter->Limit() : 0;
 	}
 
-	// Unmarshalls the parameters from the bytes in the request
-	// Moves the pointer forward to the next parameter
-	template<class Return, class Proc, class Param, class Type, class... Args>
-	bool Unpack(IXSocket client, Return result, Proc funct, str data, int &index, Param param, Type type, Args... args)
-	{	int size = 0;
-		auto var = Unmarshall(data.data() + index, &size, type);
-		auto par = PushTuple(param, var);
-		index += size;
+	// Runs the function on the pinned pool in event mode
+	// Returns false if the service has no function with the name
+	bool Pin(const str& name, int threads)
+	{
+		RPCMethod* method = Find(name);
+		if (method == NULL)
+		{	return false;
+		}
+
+		if (!method->pinned)
+		{	method->pinned = true;
+			pins++;
+		}
+
+		pinnedThreads = threads;
+		return true;
+	}
 
-		return Unpack(client, result, funct, data, index, par, args...);
+	// Returns the number of clients served on their own thread or by the reactors
+	size_t Connections()
+	{
+		size_t count = requests.size();
+		for (size_t i = 0; i < reactors.size(); i++)
+		{	std::lock_guard<std::mutex> guard(reactors[i]->lock);
+			count += reactors[i]->peers.size();
+		}
+		return count;
 	}
 
-	// Unmarshalls the last parameter from the bytes in the request
-	template<class Return, class Proc, class Param, class Type>
-	bool Unpack(IXSocket client, Return result, Proc funct, str data, int &index, Param param, Type type)
-	{	auto var = Unmarshall(data.data() + index, NULL, type);
-		auto par = PushTuple(param, var);
+	// Counts a new connection thread in thread mode
+	// Waits up to the admission timeout for another one to end if there are
+	// as many as the limit. Returns false if there was no room.
+	bool Admit()
+	{
+		std::unique_lock<std::mutex> guard(activeLock);
+		auto room = [this]() { return admission == 0 || (size_t)active < admission; };
 
-		return Unpack(client, result, funct, data, index, par);
+		if (!room() && (admissionTimeout <= 0 || !activeSignal.wait_for(guard, std::chrono::milliseconds(admissionTimeout), room)))
+		{	return false;
+		}
+
+		active++;
+		return true;
 	}
 
-	// Finishes unpacking parameters and starts executing the function
-	template<class Return, class Proc, class Param>
-	bool Unpack(IXSocket client, Return result, Proc funct, str data, int &index, Param param)
-	{	auto iSeq = std::make_index_sequence< std::tuple_size<Param>::value>{};
-		return Execute(client, result, funct, param, iSeq);
+	// Counts a connection thread ending
+	// Notifies under the lock, as the service may be deleted once it's released
+	void Leave()
+	{
+		std::lock_guard<std::mutex> guard(activeLock);
+		if (active > 0)
+		{	active--;
+		}
+		activeSignal.notify_all();
 	}
 
-	// Binds the function pointer with the parameters and executes the function
-	// Sends the client the result of the function
-	// Returns true if the data was sent successfully
-	template<class Return, class Proc, class Params, size_t... Is>
-	bool Execute(IXSocket client, Return result, Proc function, Params parameters, std::index_sequence<Is...>)
-	{	auto funct = std::bind(function, std::get<Is>(parameters)...);
-		auto data  = funct();
-		
-		str res = Marshall(data);
-		client.Send(res, (int)res.length());
-		return client.good();
+	// Executes the request of a job and sends the reply on its connection
+	// Batches flagged as parallel are split between the workers instead
+	// The deadline of the request counts from when it was queued, so requests
+	// that waited past it for a worker are dropped without running
+	// Returns the buffers to the pool and the job to the free list
+	void Complete(RPCJob* job)
+	{
+		uint mode = job->frame.header.flags;
+		if ((mode & FRAME_BATCH) != 0 && (mode & FRAME_PARALLEL) != 0 && Split(job))
+		{	return;
+		}
+
+		str  reply = "";
+		RPCMethod* method = NULL;
+		auto begun = RPCClock::now();
+		uint flags = Process(mode, job->frame.payload, reply, &method, RPCDeadline(job->frame.header.timeout, job->queued));
+
+		auto sending = RPCClock::now();
+		Reply(job, flags, reply);
+
+		if (method != NULL)
+		{	method->stats->Record(STATS_QUEUE, RPCNanos(begun - job->queued));
+			method->stats->Record(STATS_SEND, RPCNanos(RPCClock::now() - sending));
+		}
+
+		Buffers().Release(reply);
+		Free(job);
+	}
+
+	// Sends the reply to the request of a job on its connection
+	void Reply(RPCJob* job, const uint flags, const str& reply)
+	{
+		FrameSlices frame;
+		XSlice slice = XSlice{ reply.data(), reply.size() };
+		MakeFrame(frame, job->frame.header.id, flags, &slice, 1);
+
+		job->peer->Send(frame.slices, frame.count);
+		job->peer->inflight--;
+	}
+
+	// Posts every call of a batch to the workers, running the first one on
+	// the current thread. Returns false without running anything if the batch
+	// is invalid or has a single call.
+	// The split is shared by its calls, so calls the workers drop on a stop
+	// free it as well
+	bool Split(RPCJob* job)
+	{
+		std::shared_ptr<RPCSplit> split = std::make_shared<RPCSplit>();
+		split->job   = job;
+		split->flags = job->frame.header.flags & ~(FRAME_BATCH | FRAME_PARALLEL);
+		split->deadline = RPCDeadline(job->frame.header.timeout, job->queued);
+
+		std::string_view batch = job->frame.payload;
+		std::string_view call;
+
+		while (NextCall(batch, call))
+		{	split->calls.push_back(call);
+		}
+
+		size_t count = split->calls.size();
+		if (!batch.empty() || count < 2)
+		{	return false;
+		}
+
+		split->replies.resize(count);
+		split->codes.resize(count);
+		split->left = count;
+
+		for (size_t i = 1; i < count; i++)
+		{	if (!workers.Post([this, split, i]() { Run(split.get(), i); }))
+			{	Run(split.get(), i);
+			}
+		}
+
+		Run(split.get(), 0);
+		return true;
 	}
 
-	// Binds the function pointer with the parameters and executes the function
-	// Always returns true, and the request has no return
-	template< class Proc, class Params, size_t... Is>
-	bool Execute(IXSocket client, Type<void>, Proc function, Params parameters, std::index_sequence<Is...>)
-	{	auto funct = std::bind(function, std::get<Is>(parameters)...);
-		funct();
+	// Executes a call of a split batch
+	// The last call to complete sends the replies of the batch in order
+	void Run(RPCSplit* split, size_t index)
+	{
+		split->codes[index] = Process(split->flags, split->calls[index], split->replies[index], NULL, split->deadline);
+		if (--split->left != 0)
+		{	return;
+		}
+
+		str reply = Buffers().Acquire(PACKAGE_SIZE);
+		for (size_t i = 0; i < split->calls.size(); i++)
+		{	AppendReply(reply, split->codes[i], split->replies[i]);
+			Buffers().Release(split->replies[i]);
+		}
 
-		client.Send("1", 1);
-		return client.good();
+		Reply(split->job, FRAME_BATCH, reply);
+		Buffers().Release(reply);
+		Free(split->job);
+	}
+
+	// Returns a free job, or a new one if there is none
+	RPCJob* Job()
+	{	std::lock_guard<std::mutex> guard(jobLock);
+		if (jobs.empty())
+		{	made.push_back(new RPCJob{ NULL, Frame(), RPCClock::time_point(), NULL, false });
+			return made.back();
+		}
+
+		RPCJob* job = jobs.back();
+		jobs.pop_back();
+		return job;
+	}
+
+	// Drops the request of a job and keeps the job for the next request
+	// Releases the room the request held in the limiters, with its latency
+	// from when it was queued
+	void Free(RPCJob* job)
+	{	if (job->admitted)
+		{	Exit(job->method, RPCClock::now() - job->queued);
+		}
+
+		Buffers().Release(job->frame.payload);
+		job->peer     = NULL;
+		job->method   = NULL;
+		job->admitted = false;
+
+		std::lock_guard<std::mutex> guard(jobLock);
+		jobs.push_back(job);
+
+		if (draining && jobs.size() == made.size())
+		{	idleSignal.notify_all();
+		}
+	}
+
+	// Executes the request in the payload of a frame
+	// The function is looked up by the id at the start of the request if the
+	// frame is flagged with it, or by the name before the first '\n' otherwise
+	// Returns the flags of the reply, with the error flag set if the
+	// requested function does not exist or its parameters are cut short
+	// The parameters are decoded straight from the bytes of the request, in
+	// the compact encoding if the frame is flagged with it
+	// The call is counted in the function's stats, which is set as the
+	// function called unless the request is a batch
+	// Once the deadline passed, the function isn't run and the reply is
+	// flagged as expired. Otherwise the function can read the time left.
+	// Calls of cacheable functions are answered from the cache if they can be,
+	// and their successful replies are cached otherwise
+	uint Process(const uint flags, std::string_view request, str& reply, RPCMethod** called = NULL, const RPCClock::time_point deadline = RPCClock::time_point::max())
+	{
+		RPCMethod* method = NULL;
+		std::string_view params;
+
+		if ((flags & FRAME_BATCH) != 0)
+		{	return Batch(flags & ~(FRAME_BATCH | FRAME_PARALLEL), request, reply, deadline);
+		}
+
+		if ((flags & FRAME_METHOD) != 0)
+		{	if (request.size() >= METHOD_SIZE)
+			{	method = Find(ReadMethod(request.data()));
+				params = request.substr(METHOD_SIZE);
+			}
+		}
+		else
+		{	size_t split = request.find('\n');
+			method = Find(request.substr(0, split));
+			params = split != str::npos ? request.substr(split + 1) : std::string_view();
+		}
+
+		if (method == NULL)
+		{	return FRAME_ERROR;
+		}
+
+		auto start   = RPCClock::now();
+		auto decoded = start;
+
+		if (start >= deadline)
+		{	method->stats->Expire(request.size());
+			return FRAME_ERROR | FRAME_EXPIRED;
+		}
+
+		if (called != NULL)
+		{	*called = method;
+		}
+
+		// Hits are answered with the marshalled reply, without decoding the parameters
+		// Functions are told apart by their place in the table
+		RPCCacheKey key = RPCCacheKey{ (uint)(method - methods.data()), (flags & FRAME_COMPACT) != 0, params };
+		if (method->cacheable && cache != NULL)
+		{	if (cache->Get(key, reply, start))
+			{	method->stats->Hit(request.size(), reply.size());
+				return 0;
+			}
+			method->stats->Miss();
+		}
+
+		RPCClock::time_point& current = RPCCurrentDeadline();
+		RPCClock::time_point  outer   = current;
+
+		current  = deadline;
+		bool ok  = method->invoke(reply, params, key.compact, decoded);
+		auto end = RPCClock::now();
+		current  = outer;
+
+		if (!ok)
+		{	decoded = end;
+		}
+		else if (method->cacheable && cache != NULL)
+		{	cache->Put(key, reply, end);
+		}
+
+		method->stats->Call(ok, request.size(), reply.size(), RPCNanos(decoded - start), RPCNanos(end - decoded));
+		return ok ? 0 : FRAME_ERROR;
+	}
+
+	// Returns a snapshot of the counters of every function, in the order listed
+	std::vector<RPCProcedureStats> Stats()
+	{
+		std::vector<RPCProcedureStats> stats;
+		for (size_t i = 0; i < methods.size(); i++)
+		{	stats.push_back(methods[i].stats->Snapshot(methods[i].name));
+		}
+		return stats;
+	}
+
+	// Returns the names of the functions whose ids collide, in the order listed
+	std::vector<str> Collisions()
+	{
+		std::vector<str> colliding;
+		for (size_t i = 0; i < methods.size(); i++)
+		{	if (std::find(collisions.begin(), collisions.end(), methods[i].id) != collisions.end())
+			{	colliding.push_back(methods[i].name);
+			}
+		}
+		return colliding;
+	}
+
+	// Executes the calls of a batch one after the other in a single pass
+	// Every call is read with the flags given, and its reply is appended to
+	// the reply of the batch along with its own flags
+	// Returns the flags of the reply, with the error flag set if the batch is
+	// cut short, in which case the reply is empty
+	// Calls reached once the deadline passed are replied to as expired
+	uint Batch(const uint flags, std::string_view batch, str& reply, const RPCClock::time_point deadline)
+	{
+		std::string_view call;
+		str result = "";
+
+		while (NextCall(batch, call))
+		{	uint code = Process(flags, call, result, NULL, deadline);
+			AppendReply(reply, code, result);
+			result.clear();
+		}
+
+		Buffers().Release(result);
+
+		if (!batch.empty())
+		{	reply.clear();
+			return FRAME_ERROR;
+		}
+
+		return FRAME_BATCH;
+	}
+
+	// Returns the function with the name, or NULL if the service has none
+	RPCMethod* Find(std::string_view name)
+	{	auto it = names.find(name);
+		return it != names.end() ? &methods[it->second] : NULL;
+	}
+
+	// Returns the function with the id, or NULL if the service has none
+	RPCMethod* Find(const uint id)
+	{	auto it = ids.find(id);
+		return it != ids.end() ? &methods[it->second] : NULL;
+	}
+
+
+	// Builds the tables of functions when the service is created
+	// Creates an index sequence to register every function in the list,
+	// followed by the built-in function returning the service's stats as JSON
+	template<size_t... Is>
+	void Index(std::index_sequence<Is...>)
+	{	methods.reserve(sizeof...(Is) + 1);
+		(Register(std::get<Is>(RPCList)), ...);
+
+		Register(MakeMethod(STATS_METHOD, [this](str& reply, std::string_view, bool compact, RPCClock::time_point& decoded)
+		{	decoded = RPCClock::now();
+			str json = StatsJSON(Stats());
+
+			if (compact)
+			{	reply.clear();
+				Encode(reply, json);
+			}
+			else
+			{	reply = std::move(json);
+			}
+			return true;
+		}));
+	}
+
+	// Returns a function of the service calling the invoker
+	template<class Invoke>
+	static RPCMethod MakeMethod(const str& name, Invoke invoke)
+	{	return RPCMethod{ name, MethodId(name.c_str()), false, invoke, std::make_shared<RPCStats>(), 0, NULL, false };
+	}
+
+	// Adds a function to the tables with an invoker bound to its signature
+	// The first function listed with a name wins. Functions whose ids collide
+	// are left out of the id table and keep the service from starting.
+	template<class Proc>
+	void Register(const Proc& function)
+	{
+		RPCMethod method = MakeMethod(function.name, [function](str& reply, std::string_view data, bool compact, RPCClock::time_point& decoded)
+		{	return Prepare(reply, function.result, function.funct, function.params, data, compact, decoded);
+		});
+
+		method.cacheable = function.cacheable;
+		Register(std::move(method));
+	}
+
+	// Adds a function with its invoker already bound
+	void Register(RPCMethod method)
+	{
+		size_t index = methods.size();
+		uint   id    = method.id;
+
+		if (names.count(method.name) != 0)
+		{	return;
+		}
+
+		names[method.name] = index;
+		cacheable += method.cacheable ? 1 : 0;
+		methods.push_back(std::move(method));
+
+		auto it = ids.find(id);
+		if (it == ids.end() && std::find(collisions.begin(), collisions.end(), id) == collisions.end())
+		{	ids[id] = index;
+		}
+		else if (it != ids.end())
+		{	ids.erase(it);
+			collisions.push_back(id);
+		}
+	}
+
+	// Decodes the parameters from the bytes of the request in a single pass
+	// The values are built in place, in order, in a tuple that is moved into
+	// the function, so the request is never copied along the way
+	// Requests too short for their parameters fail. Raw parameters are read
+	// from offsets known at compile time, and a str parameter takes the rest
+	// of the request unless the request is compact.
+	template<class Return, class Proc, class... Types>
+	static bool Prepare(str& reply, Return result, Proc funct, std::tuple<Types...>, std::string_view data, bool compact, RPCClock::time_point& decoded)
+	{	typedef RPCLayout<typename Types::type...> Layout;
+
+		if (compact)
+		{	RPCReader reader(data);
+			std::tuple<typename Types::type...> params{ Decode(reader, Types())... };
+
+			return reader.ok && Execute(reply, result, funct, params, compact, decoded);
+		}
+
+		if (data.size() < Layout::size)
+		{	return false;
+		}
+
+		if constexpr (Layout::raw)
+		{	auto params = Load<typename Types::type...>(data.data(), std::index_sequence_for<Types...>());
+			return Execute(reply, result, funct, params, compact, decoded);
+		}
+		else
+		{	RPCReader reader(data);
+			std::tuple<typename Types::type...> params{ Unmarshall(reader, Types())... };
+
+			return reader.ok && Execute(reply, result, funct, params, compact, decoded);
+		}
+	}
+
+	// Executes the function with the parameters moved into it
+	// Marshalls the result of the function into the reply
+	// Always returns true
+	template<class Return, class Proc, class Params>
+	static bool Execute(str& reply, Return, Proc function, Params& parameters, bool compact, RPCClock::time_point& decoded)
+	{	decoded = RPCClock::now();
+		if (compact)
+		{	reply.clear();
+			Encode(reply, std::apply(function, std::move(parameters)));
+		}
+		else
+		{	reply = Marshall(std::apply(function, std::move(parameters)));
+		}
+		return true;
+	}
+
+	// Executes the function with the parameters moved into it
+	// Always returns true, and the reply is empty as the request has no return
+	template<class Proc, class Params>
+	static bool Execute(str& reply, Type<void>, Proc function, Params& parameters, bool, RPCClock::time_point& decoded)
+	{	decoded = RPCClock::now();
+		std::apply(function, std::move(parameters));
+		reply = "";
+		return true;
 	}
 };
 
@@ -198,15 +1099,131 @@ public:
 	IRPCService(List RPCList) : remote(new RPCService<List>(RPCList)) {}
 
 	// Starts the service on a specific port
-	bool Start(int port)
-	{	return remote->Start(port);
+	// Serves requests on a thread each, unless I/O threads are specified
+	// for the event mode with a pool of worker threads
+	// Returns false if the port can't be hosted, or if the ids of functions
+	// collide, in which case Collisions names them
+	bool Start(int port, int ioThreads = 0, int workerThreads = 0)
+	{	return remote->Start(port, ioThreads, workerThreads);
 	}
 
-	// Stops the service and ends all active requests
+	// Starts the service like Start, listening on the calling thread
+	// Blocks without using CPU until the service is stopped from another thread
+	bool Run(int port, int ioThreads = 0, int workerThreads = 0)
+	{	return remote->Run(port, ioThreads, workerThreads);
+	}
+
+	// Blocks the calling thread without using CPU until the service is stopped
+	void Wait()
+	{	remote->Wait();
+	}
+
+	// Stops the service, closing every connection once its running call returns
 	void Stop()
 	{	return remote->Stop();
 	}
 
+	// Stops accepting, waits up to timeout milliseconds for the requests in
+	// flight to complete and then stops the service
+	// Returns false if requests were still running at the deadline
+	bool Drain(int timeout)
+	{	return remote->Drain(timeout);
+	}
+
+	// Replies of at least threshold bytes are sent with MSG_ZEROCOPY where the
+	// system supports it. Applies to the clients connecting afterwards.
+	void ZeroCopy(int threshold)
+	{	remote->zeroCopy = threshold;
+	}
+
+	// Bounds the payload of the requests the service accepts, FRAME_MAX by
+	// default. A client sending a larger request is disconnected before its
+	// payload is read. Applies to the clients connecting afterwards.
+	void MaxFrame(size_t bytes)
+	{	remote->frameMax = bytes;
+	}
+
+	// Bounds the reply bytes queued for a client that doesn't read them, from
+	// the next start. In event mode, replies are never waited on by a worker:
+	// what the socket doesn't take is written once it has room, and a client
+	// whose queue would pass bytes is disconnected.
+	void Backlog(size_t bytes)
+	{	remote->backlog = bytes;
+	}
+
+	// Bounds the work admitted by the service, from the next start
+	// In event mode, at most limit requests wait for a worker. In thread mode,
+	// at most limit connections are served at once. Past the limit, a request
+	// or a connection waits up to timeout milliseconds for room, and is then
+	// rejected with an error or closed. A limit of 0 admits everything.
+	void Admission(size_t limit, int timeout = 0)
+	{	remote->admission = limit;
+		remote->admissionTimeout = timeout;
+	}
+
+	// Bounds the requests the service runs or queues at once, from the next start
+	// Requests past the limit are rejected straight away as overloaded, so
+	// the ones admitted keep their latency. A limit of 0 admits everything.
+	void Limit(size_t requests)
+	{	remote->limit = requests;
+	}
+
+	// Bounds the calls to a function run or queued at once, from the next start
+	// Calls in a batch are only bounded by the service's limit
+	// Returns false if the service has no function with the name
+	bool Limit(const str& name, size_t calls)
+	{	return remote->Limit(name, calls);
+	}
+
+	// Adapts the service's limit to the latency of its requests, from the next start
+	// The limit drops while requests take longer than latency milliseconds,
+	// down to the floor, and grows back while they're faster, up to the fixed
+	// limit or LIMIT_CEILING without one. A latency of 0 keeps the limit fixed.
+	void Adapt(int latency, size_t floor = 1)
+	{	remote->limitTarget = latency;
+		remote->limitFloor  = floor;
+	}
+
+	// Returns the number of requests the service currently admits at once,
+	// 0 if it has no limit
+	size_t Capacity()
+	{	return remote->Capacity();
+	}
+
+	// Bounds the cache of the functions made cacheable, from the next start
+	// The cache holds up to bytes of replies along with their parameters, and
+	// a reply is kept for ttl milliseconds, or until it's evicted if 0
+	void Cache(size_t bytes, int ttl = 0)
+	{	remote->cacheBytes = bytes;
+		remote->cacheTTL   = ttl;
+	}
+
+	// Runs a function on a separate pool of threads in event mode, so long
+	// running calls don't hold up the workers, from the next start
+	// The pinned pool has the number of threads given by the last call
+	// Returns false if the service has no function with the name
+	bool Pin(const str& name, int threads = 1)
+	{	return remote->Pin(name, threads);
+	}
+
+	// Returns the number of clients connected to the service
+	size_t Connections()
+	{	return remote->Connections();
+	}
+
+	// Returns the names of the functions whose ids collide, which keep the
+	// service from starting until one of each pair is renamed
+	std::vector<str> Collisions()
+	{	return remote->Collisions();
+	}
+
+	// Returns a snapshot of the calls, errors, bytes and latencies of every
+	// function of the service, in the order listed
+	// Also served to clients as JSON by the built-in "__stats" function
+	std::vector<RPCProcedureStats> Stats()
+	{	return remote->Stats();
+	}
+
 	// Deallocates the memory and ends the service
 	void Delete()
 	{	remote->Stop();
@@ -222,64 +1239,108 @@ struct Resource
 {
 	RPCService<List> *service;	// RPCService sevice fulfilling the request
 	XSocket *socket;			// XSocket with the connection to the client
+	unsigned long long key;		// Key of the request in the service's registry
 };
 
 //Listens to new connections
 template <class Type>
-DWORD WINAPI serverFn(LPVOID lparameter)
+unsigned long XTHREAD_CALL serverFn(void* lparameter)
 {
 	RPCService<Type> *remote = (RPCService<Type>*)lparameter;
-	Resource<Type> resource;
-	resource.service = remote;
-
 	IXSocket client;
 
-	while (remote->server.good())
+	while (remote->server.good() && !remote->draining)
 	{
 		client = remote->server.Accept();
 
-		if (client.good())
-		{
-			resource.socket = client.xsocket;
-			void* address = CreateThread(NULL, NULL, processFn<Type>, &resource, NULL, NULL);
+		if (client.good() && remote->zeroCopy > 0)
+		{	client.ZeroCopy(remote->zeroCopy);
+		}
 
-			if (address != NULL)
-			{	remote->requests.push_back(Request{ client, address });
+		if (client.good() && remote->draining)
+		{	client.Delete();
+		}
+		else if (client.good() && !remote->reactors.empty())
+		{
+			remote->Attach(client);
+		}
+		else if (client.good() && remote->Admit())
+		{
+			// Each thread gets its own resources, freed by the thread
+			// The request is registered first, so the thread can remove it however soon it ends
+			unsigned long long key = remote->requests.Add(Request{ client, NULL });
+			Resource<Type>* resource = new Resource<Type>{ remote, client.xsocket, key };
+			void* address = XCreateThread(processFn<Type>, resource);
+
+			Request removed;
+			if (address == NULL)
+			{	delete resource;
+				if (remote->requests.Remove(key, removed))
+				{	client.Delete();
+				}
+				remote->Leave();
 			}
-			else
-			{	client.Delete();
+			else if (!remote->requests.Attach(key, address))
+			{	XReleaseThread(address);
 			}
 		}
+		else if (client.good())
+		{	client.Delete();
+		}
 	}
 
-	remote->server.Close();
-	remote->serverThr = NULL;
+	remote->Listened();
 	return 0;
 }
 
 //Fulfills requests
+//Keeps serving requests on the connection until the client closes it
+//The deadline of a request counts from when it was read
+//Requests past the limiters are rejected as overloaded without running
 template <class Type>
-DWORD WINAPI processFn(LPVOID lparameter)
+unsigned long XTHREAD_CALL processFn(void* lparameter)
 {
 	Resource<Type> res = *(Resource<Type>*)lparameter;
 	IXSocket client(res.socket);
+	delete (Resource<Type>*)lparameter;
+
+	FrameHeader header;
+	str request = "";
+	size_t max  = res.service->frameMax;
+
+	while (client.good() && RecvFrame(client, header, request, max))
+	{	str  reply = "";
+		RPCMethod* method = NULL;
+		RPCMethod* target = res.service->limited > 0 ? res.service->Method(header.flags, request) : NULL;
+		auto received = RPCClock::now();
+
+		if (!res.service->Enter(target))
+		{	if (target != NULL)
+			{	target->stats->Reject(request.size());
+			}
+			SendFrame(client, header.id, FRAME_ERROR | FRAME_OVERLOADED, reply);
+			continue;
+		}
 
-	str request  = "";
-	str function = "";
-	str params   = "";
+		uint flags = res.service->Process(header.flags, request, reply, &method, RPCDeadline(header.timeout, received));
 
-	if (client.good())
-		request = client.Recv(NULL, 256);
+		auto sending = RPCClock::now();
+		SendFrame(client, header.id, flags, reply);
+		res.service->Exit(target, RPCClock::now() - received);
 
-	if (client.good())
-	{	function = request.substr(0, request.find('\n'));
-		params   = request.substr(1 + request.find('\n'));
-		res.service->Parse(client, function, params);
+		if (method != NULL)
+		{	method->stats->Record(STATS_SEND, RPCNanos(RPCClock::now() - sending));
+		}
 	}
-	else
-	{	client.Delete();
+
+	// Stop removes the request first while ending the service, and then owns the socket
+	Request removed;
+	if (res.service->requests.Remove(res.key, removed))
+	{	removed.client.Delete();
+		XReleaseThread(removed.thread);
 	}
 
+	res.service->Leave();
 	return 0;
 }
 
@@ -287,58 +1348,70 @@ DWORD WINAPI processFn(LPVOID lparameter)
 // Opens a connection to the remote computer serving requests
 // Deconstructs parameters into a Byte array
 // Sends the request to the remote computer and waits for the result
-template<class Return, class... Args>
-bool RPC(cstr address, int port, Return &data, str function, Args... args)
+// Fails once the reply took longer than RPC_TIMEOUT milliseconds
+// The result is never an array, so a literal name goes to the overload below
+template<class Return, class... Args> requires (!std::is_array_v<Return>)
+bool RPC(cstr address, int port, Return &data, str function, const Args&... args)
 {
 	IXSocket conn;
 	str params = Package(args...);
-	str request = function + '\n' + params;
 	str result = "";
+	FrameHeader  header = FrameHeader{};
+	MethodSlices request;
+	bool ok = false;
 
-	conn.Open(TCP, address, port, 1);
+	RPCClock::time_point deadline = RPCCallDeadline(RPC_TIMEOUT);
+	uint timeout = RPCTimeout(deadline);
 
-	if (conn.good())
-	{	conn.Send(request, (int)request.length());
-	}
+	conn.Open(TCP, address, port, timeout > 0 && timeout < XSOCKET_CTIME ? (int)timeout : XSOCKET_CTIME);
 
-	if (conn.good())
-	{	result = conn.Recv(NULL, 256);
-	}
+	MakeRequest(request, MethodId(function.c_str()), params);
+	timeout = RPCTimeout(deadline);
+	conn.Timeout((int)timeout);
 
-	if (result != "")
-	{	data = Unmarshall(result.data(), NULL, Type<Return>());
+	if (conn.good() && RPCClock::now() < deadline && SendFrame(conn, 0, FRAME_METHOD, request.slices, 2, timeout))
+	{	ok = RecvFrame(conn, header, result) && (header.flags & FRAME_ERROR) == 0;
 	}
 
+	ok = ok && Extract(result, false, data);
+
+	Buffers().Release(params);
 	conn.Delete();
-	return result != "";
+	return ok;
 }
 
 
 // Opens a connection to the remote computer serving requests
 // Deconstructs parameters into a Byte array
-// Sends the request to the remote computer
+// Sends the request to the remote computer and waits for it to complete
+// Fails once the reply took longer than RPC_TIMEOUT milliseconds
+// The name is a C string, so a string result is never taken for the name
 template<class... Args>
-auto RPC(cstr address, int port, str function, Args... args)
+auto RPC(cstr address, int port, cstr function, const Args&... args)
 {
 	IXSocket conn;
 	str params = Package(args...);
-	str request = function + '\n' + params;
 	str result = "";
-	
-	conn.Open(TCP, address, port, 1);
+	FrameHeader  header = FrameHeader{};
+	MethodSlices request;
+	bool ok = false;
 
-	if (conn.good())
-	{	conn.Send(request, (int)request.length());
-	}
+	RPCClock::time_point deadline = RPCCallDeadline(RPC_TIMEOUT);
+	uint timeout = RPCTimeout(deadline);
 
-	if (conn.good())
-	{	result = conn.Recv(NULL, 256);
-	}
+	conn.Open(TCP, address, port, timeout > 0 && timeout < XSOCKET_CTIME ? (int)timeout : XSOCKET_CTIME);
+
+	MakeRequest(request, MethodId(function), params);
+	timeout = RPCTimeout(deadline);
+	conn.Timeout((int)timeout);
 
-	bool sent = conn.good();
+	if (conn.good() && RPCClock::now() < deadline && SendFrame(conn, 0, FRAME_METHOD, request.slices, 2, timeout))
+	{	ok = RecvFrame(conn, header, result) && (header.flags & FRAME_ERROR) == 0;
+	}
 
+	Buffers().Release(params);
 	conn.Delete();
-	return result != "";
+	return ok;
 }
 
 
@@ -349,42 +1422,4 @@ auto MakeIRPCService(List RPCList)
 }
 
 
-// Packages information from parameters into a Byte array.
-// Packing is done recursively untill there's only one parameter left.
-static str Package()
-{	return "";
-}
-
-template <class Type>
-static str Package(Type data)
-{	return Marshall(data);
-}
-
-template<class Type, class... Args>
-static str Package(Type data, Args... variadic)
-{	return Marshall(data) + Package(variadic...);
-}
-
-// Breaks down data types into Byte arrays
-// Byte arrays can be sent through the network
-str Marshall(char      raw);
-str Marshall(short     raw);
-str Marshall(int       raw);
-str Marshall(long      raw);
-str Marshall(long long raw);
-str Marshall(float     raw);
-str Marshall(double    raw);
-str Marshall(cstr      raw);
-str Marshall(str       raw);
-
-// Casts data from Byte arrays into the specified data type
-// Assigns the number of bytes consumed in size if pointer is not null
-char Unmarshall(cstr data, int* size, Type<char>);
-short Unmarshall(cstr data, int* size, Type<short>);
-int Unmarshall(cstr data, int* size, Type<int>);
-long Unmarshall(cstr data, int* size, Type<long>);
-long long Unmarshall(cstr data, int* size, Type<long long>);
-float Unmarshall(cstr data, int* size, Type<float>);
-double Unmarshall(cstr data, int* size, Type<double>);
-
 #endif
\ No newline at end of file
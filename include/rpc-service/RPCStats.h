@@ -0,0 +1,132 @@
+#ifndef RPCSTATS_H
+#define RPCSTATS_H
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+typedef std::string   str;
+typedef const char*   cstr;
+typedef unsigned char byte;
+typedef unsigned int  uint;
+
+// Clock timing the phases of the calls
+typedef std::chrono::steady_clock RPCClock;
+
+// Phases of a call, from its request to its reply
+#define STATS_DECODE  0			// Decoding the parameters from the request
+#define STATS_QUEUE   1			// Waiting for a worker, in event mode
+#define STATS_EXECUTE 2			// Running the function and marshalling its result
+#define STATS_SEND    3			// Sending the reply
+#define STATS_PHASES  4
+
+// Number of independently updated copies of the counters of a function
+#define STATS_SHARDS 4
+
+// Latencies are counted in buckets of 2^STATS_SUB_BITS steps per power of two
+// nanoseconds, so every bucket is within 12.5% of the latencies it holds
+#define STATS_SUB_BITS 3
+#define STATS_SUB      (1 << STATS_SUB_BITS)
+
+// Number of powers of two in the histograms, up to 2^38 ns (about 4.5 minutes)
+#define STATS_GROUPS  36
+#define STATS_BUCKETS (STATS_GROUPS * STATS_SUB)
+
+
+// Returns the number of nanoseconds of a duration, 0 if negative
+inline unsigned long long RPCNanos(RPCClock::duration duration)
+{	long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+	return ns > 0 ? (unsigned long long)ns : 0;
+}
+
+
+// Counters of the calls recorded by a group of threads
+// Aligned to its own cache lines, so threads of different shards never
+// write to the same line
+struct alignas(64) RPCStatShard
+{
+	std::atomic<unsigned long long> calls;		// Number of calls
+	std::atomic<unsigned long long> errors;		// Number of calls that failed
+	std::atomic<unsigned long long> expired;	// Number of calls dropped as their deadline passed
+	std::atomic<unsigned long long> overloaded;	// Number of calls rejected by the limiters
+	std::atomic<unsigned long long> hits;		// Number of calls answered from the cache
+	std::atomic<unsigned long long> misses;		// Number of calls of a cacheable function that ran
+	std::atomic<unsigned long long> bytesIn;	// Bytes of the requests
+	std::atomic<unsigned long long> bytesOut;	// Bytes of the replies
+	std::atomic<unsigned long long> total[STATS_PHASES];					// Nanoseconds spent in each phase
+	std::atomic<unsigned long long> buckets[STATS_PHASES][STATS_BUCKETS];	// Latencies of each phase
+};
+
+
+// Latencies of a phase of the calls to a function, merged from every shard
+// Buckets grow exponentially like an HDR histogram, with linear steps
+// within each power of two
+class RPCHistogram
+{
+public:
+	unsigned long long count;				// Number of latencies
+	unsigned long long total;				// Sum of the latencies in nanoseconds
+	std::vector<unsigned long long> buckets;	// Number of latencies in each bucket
+
+	// Public constructors
+	RPCHistogram();
+
+	// Public methods
+	double Mean() const;
+	unsigned long long Percentile(double percentile) const;
+	unsigned long long Max() const;
+
+	static size_t Bucket(unsigned long long ns);
+	static unsigned long long Lower(size_t bucket);
+	static unsigned long long Upper(size_t bucket);
+};
+
+
+// Snapshot of the counters of a function
+struct RPCProcedureStats
+{
+	str name;							// Name of the function
+	unsigned long long calls;			// Number of calls
+	unsigned long long errors;			// Number of calls that failed
+	unsigned long long expired;			// Number of calls dropped as their deadline passed, counted as failed
+	unsigned long long overloaded;		// Number of calls rejected by the limiters, counted as failed
+	unsigned long long hits;			// Number of calls answered from the cache
+	unsigned long long misses;			// Number of calls of a cacheable function that ran
+	unsigned long long bytesIn;			// Bytes of the requests
+	unsigned long long bytesOut;		// Bytes of the replies
+	RPCHistogram phases[STATS_PHASES];	// Latencies of each phase
+};
+
+
+// Counters of the calls to a function of a service
+// Every thread records into one of the shards with relaxed atomic adds, so
+// recording a call takes no lock and costs a few nanoseconds. Snapshots
+// add the shards up while calls keep being recorded.
+class RPCStats
+{
+public:
+	RPCStatShard shards[STATS_SHARDS];	// Counters updated by different threads
+
+	// Public constructors
+	RPCStats();
+
+	// Public methods
+	void Call(bool ok, size_t bytesIn, size_t bytesOut, unsigned long long decode, unsigned long long execute);
+	void Record(int phase, unsigned long long ns);
+	void Expire(size_t bytesIn);
+	void Reject(size_t bytesIn);
+	void Hit(size_t bytesIn, size_t bytesOut);
+	void Miss();
+	RPCProcedureStats Snapshot(const str& name);
+
+	// Private methods
+	RPCStatShard& Shard();
+};
+
+
+// Serializes snapshots of the functions of a service as a JSON object
+// Latencies are given in nanoseconds, with the mean and percentiles of each phase
+str StatsJSON(const std::vector<RPCProcedureStats>& procedures);
+
+#endif
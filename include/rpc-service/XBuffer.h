@@ -0,0 +1,66 @@
+#ifndef XBUFFER_H
+#define XBUFFER_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+typedef std::string   str;
+typedef const char*   cstr;
+typedef unsigned char byte;
+typedef unsigned int  uint;
+
+// Smallest pooled buffer is 2^XBUFFER_MIN bytes, the largest 2^XBUFFER_MAX
+// Larger buffers are freed when released rather than kept
+#define XBUFFER_MIN 6
+#define XBUFFER_MAX 20
+
+// Number of size classes between the smallest and largest buffers
+#define XBUFFER_CLASSES (XBUFFER_MAX - XBUFFER_MIN + 1)
+
+// Largest number of free buffers kept in a size class
+#define XBUFFER_KEEP 256
+
+// Largest number of bytes held by the free buffers of a size class
+#define XBUFFER_RETAIN (8 << 20)
+
+
+// Free buffers of one size class
+struct XBufferClass
+{
+	std::mutex lock;				// Guards the list of buffers
+	std::vector<str> free;			// Empty strings holding their memory
+	size_t keep;					// Largest number of free buffers kept
+};
+
+
+// Pool of string buffers recycled between calls
+// Buffers are sorted in power of two size classes by their capacity. Released
+// buffers keep their memory and are handed out again by the next request for
+// a buffer of their class, so a call in a steady state doesn't allocate.
+// Each class keeps at most XBUFFER_RETAIN bytes, so a burst of large calls
+// doesn't leave its memory held by the pool.
+// Buffers are plain strings, and can be released by a different thread than
+// the one that acquired them, or not released at all.
+class XBufferPool
+{
+public:
+	XBufferClass classes[XBUFFER_CLASSES];	// Free buffers by size class
+	std::atomic<long long> hits;			// Requests served with a free buffer
+	std::atomic<long long> misses;			// Requests that had to allocate a buffer
+
+	// Public constructors
+	XBufferPool();
+
+	// Public methods
+	str  Acquire(const size_t size);
+	void Release(str& buffer);
+	void Grow(str& buffer, const size_t size);
+};
+
+
+// Returns the pool shared by the sockets, frames and marshalling
+XBufferPool& Buffers();
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef XREACTOR_H
+#define XREACTOR_H
+
+#include "XSocket.h"
+#include "RPCFrame.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+#include <atomic>
+#include <vector>
+
+// Largest number of bytes waiting to be written to a peer, past which it's closed
+#define REACTOR_BACKLOG (16 << 20)
+
+// Milliseconds a write to a peer waits for the kernel to be done with the
+// memory of a zero-copy send, past which the peer is closed
+#define REACTOR_REAP 1000
+
+
+class XReactor;
+
+// Connected socket owned by a reactor along with the frames it's decoding
+// Peers are shared between the reactor reading from them and the threads
+// writing to them, and the socket is deleted with the last reference.
+// Writes never wait for the socket: the bytes it doesn't take are queued,
+// and written by the reactor once the socket has room again. A peer that
+// doesn't read what it's sent is closed once its queue passes the backlog.
+struct XPeer
+{
+	XSocket*     socket;		// Socket of the connection
+	XReactor*    reactor;		// Reactor watching the socket and writing the queued bytes
+	FrameDecoder decoder;		// Decoder of the bytes read from the connection
+	std::mutex   sendLock;		// Guards the output and keeps frames written by different threads whole
+	str          output;		// Bytes the socket didn't take yet
+	size_t       flushed;		// Number of bytes at the front of the output already written
+	size_t       backlog;		// Largest number of bytes waiting in the output
+	std::atomic<bool> waiting;	// Flag of wether the output waits for the socket to have room
+	std::atomic<int> inflight;	// Number of requests in flight on the connection
+
+	// Public constructors
+	XPeer(XSocket* _socket, XReactor* _reactor, size_t _backlog = REACTOR_BACKLOG);
+	~XPeer();
+
+	// Public methods
+	bool Send(const str& data);
+	bool Send(const XSlice* slices, const int count, bool* unsent = NULL);
+	bool Flush();
+	bool Stale();
+	bool good();
+
+	// Private methods
+	void Fail();
+};
+
+// Callback receiving the complete frames read from a peer
+typedef std::function<void(std::shared_ptr<XPeer> peer, std::vector<Frame>& frames)> XReactorFn;
+
+// Callback notified when a peer disconnected and was removed from the reactor
+typedef std::function<void(std::shared_ptr<XPeer> peer)> XReactorCloseFn;
+
+// Callback run by the event loop before every wait
+// Returns the milliseconds the loop may wait for events before running it
+// again, or -1 to wait for events only
+typedef std::function<int()> XReactorTimerFn;
+
+
+// Event loop multiplexing many connected sockets on one thread
+// The reactor keeps reading from every peer while the frames it already
+// handed out are being processed, so requests and replies can be pipelined.
+// The reactor holds a reference to every peer until they disconnect.
+class XReactor
+{
+public:
+	XReactorFn      callback;		// Function receiving frames from the peers
+	XReactorCloseFn closed;			// Function notified of disconnected peers
+	XReactorTimerFn timer;			// Function run before every wait of the loop
+	std::thread loopThr;			// Thread running the event loop
+	std::atomic<bool> running;		// Flag of wether the event loop should keep running
+
+	std::mutex  lock;				// Guards the map of peers
+	std::unordered_map<XPeer*, std::shared_ptr<XPeer> > peers;	// Peers owned by the reactor
+	size_t      backlog;			// Largest number of bytes waiting to be written to each peer
+
+	std::mutex              flushLock;		// Orders the wakes of the threads waiting for the output
+	std::condition_variable flushSignal;	// Wakes the threads waiting for every output to be written
+
+#ifndef _WIN32
+	int pollObj;					// Epoll instance watching the sockets
+	int wakeObj;					// Event descriptor interrupting the wait
+#endif
+
+	// Public constructors
+	XReactor();
+	~XReactor();
+
+	// Public methods
+	bool Start(XReactorFn fn, XReactorCloseFn closeFn = XReactorCloseFn(), XReactorTimerFn timerFn = XReactorTimerFn());
+	std::shared_ptr<XPeer> Add(IXSocket conn, const size_t frameMax = FRAME_MAX);
+	void Remove(XPeer* peer);
+	bool Flush(std::chrono::steady_clock::time_point deadline);
+	void Wake();
+	void Stop();
+	void Close();
+
+	// Private methods
+	void Loop();
+	void Read(std::shared_ptr<XPeer> peer);
+	void Watch(XPeer* peer, bool writable);
+	void Flushed();
+	bool Idle();
+	std::shared_ptr<XPeer> Find(XPeer* peer);
+};
+
+#endif
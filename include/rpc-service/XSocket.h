@@ -7,12 +7,33 @@
 #define TCP 1
 #define UDP 2
 
+#ifdef _WIN32
+// Keeps windows.h from defining min and max, and from including winsock 1
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #include <windows.h>
-#include <string>
 
 #pragma comment(lib,"ws2_32.lib")
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+typedef int SOCKET;
+#define INVALID_SOCKET (-1)
+#endif
+
+#include <string>
+#include <vector>
 
 typedef std::string   str;
 typedef const char*   cstr;
@@ -20,6 +41,21 @@ typedef unsigned char byte;
 typedef unsigned int  uint;
 
 
+// Largest number of slices handed to the system in one vectored send
+#define XSOCKET_SLICES 16
+
+// Milliseconds allowed to establish a connection by default
+#define XSOCKET_CTIME 1000
+
+// Milliseconds waited before connecting again to refusing addresses
+// The wait doubles with every round, up to the maximum
+#define XSOCKET_BACKOFF_MIN 10
+#define XSOCKET_BACKOFF_MAX 500
+
+// Milliseconds a connection attempt is given before the next address is tried alongside it
+#define XSOCKET_STAGGER 250
+
+
 struct Message
 {
 	const str	data;			// Content of the message
@@ -27,24 +63,45 @@ struct Message
 };
 
 
+// Address of a remote host resolved from its name, of any family
+struct XAddress
+{
+	sockaddr_storage address;	// Address in the layout of its family
+	socklen_t        size;		// Number of bytes of the address
+};
+
+
+// Slice of memory sent as part of a vectored send
+struct XSlice
+{
+	cstr   data;				// First byte of the slice
+	size_t size;				// Number of bytes in the slice
+};
+
+
 class XSocket
 {
 public:
-	uint  socketObj;			// Unsigned Integer memory address to the socket object
-	void* connectThr;			// Handle to the thread responsible for establishing connection
+	SOCKET socketObj;			// Handle of the socket object
 
 	int  port;					// Port of the connection
 	int  type;					// Protocol of the connection
-	int  ctime;					// Maximum time limit to establish connection
+	int  ctime;					// Milliseconds allowed to establish connection
+	int  rtime;					// Milliseconds a read waits for data, 0 to wait forever
+	int  backlog;				// Maximum length of the queue of pending connections
+	int  zeroCopy;				// Smallest send made with MSG_ZEROCOPY, 0 if disabled
 	bool host;					// Flag of wether the socket is a server or not
 	byte flag;					// Error flags of the connection keeping the socket safe
 	str  addr;					// IPv4 Address of the connection
 
+#ifdef _WIN32
 	WSAData	    wsaData;		// Windows networking information structure
+#else
+	int         pollObj;		// Epoll instance waiting on the readiness of the socket
+#endif
 	sockaddr_in addrInfo;		// Address information structure
 
 	// Elements access to the class's services
-	static friend DWORD WINAPI connectFn(LPVOID lpParameter);
 	friend class IXSocket;
 
 	// Private constructors
@@ -53,16 +110,41 @@ public:
 
 	// Private methods
 	void Close();
-	void Host(const int _type, const int _port);
+	void Shutdown(const bool sends = false);
+	void Host(const int _type, const int _port, const int _backlog);
 	void Open(const int _type, const str _addr, const int _port, const int _ctime);
-	void Send(const str data,  const int size,  const sockaddr_in address);
-	void Send(const str data,  const int size);
+	void Send(const str& data, const int size,  const sockaddr_in address);
+	void Send(const str& data, const int size);
+	void Send(const XSlice* slices, const int count);
+	long Write(const XSlice* slices, const int count, const size_t offset, const int timeout);
 	str  Recv(sockaddr_in* address, const int maxSize);
+	bool Read(char* buffer, const int size);
+	void ZeroCopy(const int threshold);
+	void Timeout(const int timeout);
 	XSocket* Accept();
 
+#ifndef _WIN32
+	bool Wait(const uint events, const int timeout);
+	bool Reap(const int sends, const int timeout);
+#endif
 };
 
 
+// Resolves the name or numeric address of a host into every address it has
+// Addresses alternate between families, starting with the first one found
+// Returns an empty list if the host can not be resolved
+std::vector<XAddress> XResolve(const str& host, const int port, const int type);
+
+// Connects a new TCP socket to one of the addresses, racing them in turn
+// Each attempt is given XSOCKET_STAGGER milliseconds before the next address
+// is tried alongside it, and the first to connect wins. Once every address
+// has failed, refused ones are tried again after a doubling backoff.
+// The wait is spent in poll, so connecting costs no CPU.
+// Returns the connected non-blocking socket, or INVALID_SOCKET once the
+// timeout in milliseconds has passed. Sets the index of the address used.
+SOCKET XConnect(const std::vector<XAddress>& addresses, const int timeout, size_t* used);
+
+
 class IXSocket
 {
 public:
@@ -76,17 +158,26 @@ public:
 	IXSocket();
 	IXSocket(const IXSocket& obj);
 
+	// Public operators
+	IXSocket& operator=(const IXSocket& obj);
+
 	// Public methods
 	IXSocket Accept();
-	void Host(const int _type, const int _port);
+	void Host(const int _type, const int _port, const int _backlog = SOMAXCONN);
 	void Open(const int _type, const str _addr, const int _port, const int _ctime);
-	void Send(const str data,  const int size,  const sockaddr_in address);
-	void Send(const str data,  const int size);
+	void Send(const str& data, const int size,  const sockaddr_in address);
+	void Send(const str& data, const int size);
+	void Send(const XSlice* slices, const int count);
+	long Write(const XSlice* slices, const int count, const size_t offset, const int timeout);
 	str  Recv(sockaddr_in* address, const int maxSize);
+	bool Read(char* buffer, const int size);
+	void ZeroCopy(const int threshold);
+	void Timeout(const int timeout);
 	void Close();
+	void Shutdown(const bool sends = false);
 	void Delete();
 	bool good();
 
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,92 @@
+#ifndef XTHREAD_H
+#define XTHREAD_H
+
+#ifdef _WIN32
+// Keeps windows.h from defining min and max, and from including winsock 1
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <windows.h>
+#define XTHREAD_CALL WINAPI
+#else
+#define XTHREAD_CALL
+#endif
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <deque>
+
+// Entry point of a thread started with XCreateThread
+// Matches the signature of a Win32 thread procedure
+typedef unsigned long (XTHREAD_CALL *XThreadFn)(void* parameter);
+
+// Starts a new thread running the function with the parameter
+// Returns a handle to the thread, or NULL on failure
+void* XCreateThread(XThreadFn function, void* parameter);
+
+// Forcefully stops a thread started with XCreateThread
+// The handle must not be used after the call
+void XTerminateThread(void* thread);
+
+// Waits up to timeout milliseconds for a thread started with XCreateThread to end
+// Negative timeouts wait indefinitely. Returns true if the thread has ended
+bool XWaitThread(void* thread, int timeout);
+
+// Drops the handle of a thread started with XCreateThread, leaving it running
+// Can be called from the thread itself. The handle must not be used after the call
+void XReleaseThread(void* thread);
+
+
+// Tasks waiting for one worker of a pool
+// The worker takes tasks from the front, idle workers steal from the back
+struct XWorkQueue
+{
+	std::mutex lock;							// Guards the tasks
+	std::deque<std::function<void()> > tasks;	// Tasks in the order they were posted
+};
+
+
+// Fixed number of worker threads executing tasks from their own queues
+// Tasks posted from outside the pool go to the queues in turn, tasks posted by
+// a worker go to its own queue. A worker with an empty queue steals from the
+// others before going to sleep. With a capacity, at most that many tasks wait
+// in the queues, and posting more waits for room or fails.
+class XThreadPool
+{
+public:
+	std::vector<std::thread> workers;			// Threads executing the tasks
+	std::vector<XWorkQueue*> queues;			// Tasks waiting for each worker
+	std::mutex lock;							// Guards sleeping, waiting for room and stopping
+	std::condition_variable signal;				// Wakes workers when tasks are posted
+	std::condition_variable room;				// Wakes posters when a task is taken
+	std::atomic<size_t> queued;					// Number of tasks waiting in the queues
+	std::atomic<size_t> next;					// Number of tasks posted from outside the pool
+	std::atomic<int> sleeping;					// Number of workers waiting for tasks
+	std::atomic<int> blocked;					// Number of posters waiting for room
+	size_t capacity;							// Largest number of waiting tasks, 0 for no limit
+	std::atomic<bool> running;					// Flag of wether workers should keep running, set under the lock
+
+	// Public constructors
+	XThreadPool();
+	~XThreadPool();
+
+	// Public methods
+	bool Start(int threads, size_t capacity = 0);
+	bool Post(std::function<void()> task, int timeout = 0);
+	void Stop();
+
+	// Private methods
+	bool Reserve(int timeout);
+	bool Take(size_t index, std::function<void()>& task);
+	void Loop(size_t index);
+};
+
+#endif
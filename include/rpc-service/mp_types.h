@@ -2,6 +2,8 @@
 #define META_TYPES
 
 #include <tuple>
+#include <utility>
+#include <cstddef>
 
 template<class T>
 class Type 
@@ -26,28 +28,21 @@ class TypeList
 };
 
 //Push Tuple
+template<class Tuple, class Data, std::size_t... Is>
+static auto PushTuple(Tuple tuple, Data data, std::index_sequence<Is...>)
+{	return std::make_tuple(std::get<Is>(tuple)..., data);
+}
+
 template<class Tuple, class Data>
 static auto PushTuple(Tuple tuple, Data data)
 {	auto size = std::make_index_sequence< std::tuple_size<Tuple>::value>{};
 	return PushTuple(tuple, data, size);
 }
 
-template<class Tuple, class Data, size_t... Is>
-static auto PushTuple(Tuple tuple, Data data, std::index_sequence<Is...>)
-{	return std::make_tuple(std::get<Is>(tuple)..., data);
-}
-
 
 //Pop Tuple
-template<class Tuple>
-static auto PopTuple(Tuple tuple)
-{	auto size = std::make_index_sequence< std::tuple_size<Tuple>::value>{};
-	return PopTuple(tuple, size);
-}
-
-template<class Tuple, size_t... Is>
-static auto PopTuple(Tuple tuple, std::index_sequence<Is...>)
-{	return PopTuple(std::get<Is>(tuple)...);
+inline auto PopTuple()
+{	return std::tuple<>();
 }
 
 template<class Pop, class... Args>
@@ -55,8 +50,15 @@ static auto PopTuple(Pop val, Args... tuple)
 {	return std::make_tuple(tuple...);
 }
 
-static auto PopTuple()
-{	return std::tuple<>();
+template<class Tuple, std::size_t... Is>
+static auto PopTuple(Tuple tuple, std::index_sequence<Is...>)
+{	return PopTuple(std::get<Is>(tuple)...);
+}
+
+template<class Tuple>
+static auto PopTuple(Tuple tuple)
+{	auto size = std::make_index_sequence< std::tuple_size<Tuple>::value>{};
+	return PopTuple(tuple, size);
 }
 
 #endif
\ No newline at end of file
@@ -3,18 +3,19 @@
 
 // Writes all parameters to the console
 // Unpacks parameters recursively
-template<class T, class... Args>
-void console(T data, Args... args)
+template<class T>
+void console(T data)
 {	std::cout << data;
-	console(args...);
 }
 
-template<class T>
-void console(T data)
+template<class T, class... Args>
+void console(T data, Args... args)
 {	std::cout << data;
+	console(args...);
 }
 
-//Abstract Data Type of an int and a boolean
+//Abstract Data Type of an int and a float
+//Trivially copyable, so it is sent as its bytes without overloads
 class ADT
 {
 public:
@@ -31,16 +32,7 @@ public:
 	}
 };
 
-// Overloading the Marshall and Unmarshall functions (RPC operators)
-// Overloading allows the RPC send and receive ADT objects.
-str Marshall(ADT raw)
-{	return str((char*)&raw, sizeof(raw));
-}
-ADT Unmarshall(cstr data, int* size, Type<ADT>)
-{	if (size != NULL) { *size = sizeof(ADT); } return *(ADT*)data;
-}
-
-void main()
+int main()
 {
 	float fresult = 0;
 	int   iresult = 0;
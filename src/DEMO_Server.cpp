@@ -4,18 +4,19 @@
 
 // Writes all parameters to the console
 // Unpacks parameters recursively
-template<class T, class... Args>
-void console(T data, Args... args)
+template<class T>
+void console(T data)
 {	std::cout << data;
-	console(args...);
 }
 
-template<class T>
-void console(T data)
+template<class T, class... Args>
+void console(T data, Args... args)
 {	std::cout << data;
+	console(args...);
 }
 
-//Abstract Data Type of an int and a boolean
+//Abstract Data Type of an int and a float
+//Trivially copyable, so it is sent as its bytes without overloads
 class ADT
 {
 public:
@@ -32,15 +33,6 @@ public:
 	}
 };
 
-// Overloading the Marshall and Unmarshall functions (RPC operators)
-// Overloading allows the RPC send and receive ADT objects.
-str Marshall(ADT raw)
-{	return str((char*)&raw, sizeof(raw));
-}
-ADT Unmarshall(cstr data, int* size, Type<ADT>)
-{	if (size != NULL) { *size = sizeof(ADT); } return *(ADT*)data;
-}
-
 
 // Test function that prints an abstract datatype and returns the sum of 2 integers.
 // Should be called by the Execute function.
@@ -61,7 +53,7 @@ void NoFunction()
 {
 }
 
-void main()
+int main()
 {	//Create RPC Handler with available functions
 	auto RPCs = std::make_tuple(
 		MakeFunction("NoFunction", Type<void>(), NoFunction, std::tuple<>()),
@@ -70,8 +62,10 @@ void main()
 	);
 
 	auto service = MakeIRPCService(RPCs);
-	
-	if(service.Start(7971))
-	{	while (true) {}
+
+	// Serves on the main thread until the service is stopped
+	if (!service.Run(7971))
+	{	console("Failed to start the service on port 7971\n");
+		return 1;
 	}
 }
\ No newline at end of file
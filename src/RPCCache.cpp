@@ -0,0 +1,112 @@
+#include <rpc-service/RPCCache.h>
+#include <rpc-service/XBuffer.h>
+
+#include <iterator>
+
+// Creates an empty cache holding up to bytes of calls
+// The bytes are split evenly between the shards
+RPCCache::RPCCache(size_t bytes, RPCClock::duration _ttl)
+: capacity(bytes / CACHE_SHARDS), ttl(_ttl), evictions(0)
+{
+	for (int i = 0; i < CACHE_SHARDS; i++)
+	{	shards[i].bytes = 0;
+	}
+}
+
+
+// Copies the cached reply of the call into the reply
+// Returns false if the call isn't cached or its reply went stale
+bool RPCCache::Get(const RPCCacheKey& key, str& reply, RPCClock::time_point now)
+{
+	size_t hash = RPCCacheHash()(key);
+	RPCCacheShard& shard = shards[hash % CACHE_SHARDS];
+	std::lock_guard<std::mutex> guard(shard.lock);
+
+	auto found = shard.index.find(key);
+	if (found == shard.index.end())
+	{	return false;
+	}
+
+	auto entry = found->second;
+	if (ttl != RPCClock::duration::zero() && now >= entry->expires)
+	{	Erase(shard, entry);
+		return false;
+	}
+
+	shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+
+	Buffers().Grow(reply, entry->reply.size());
+	reply.assign(entry->reply);
+	return true;
+}
+
+
+// Keeps the reply of the call, replacing the one cached already
+// Evicts the least recently used calls of the shard until the reply fits
+// Replies larger than a shard are not cached
+void RPCCache::Put(const RPCCacheKey& key, const str& reply, RPCClock::time_point now)
+{
+	size_t cost = CACHE_OVERHEAD + key.params.size() + reply.size();
+	if (cost > capacity)
+	{	return;
+	}
+
+	size_t hash = RPCCacheHash()(key);
+	RPCCacheShard& shard = shards[hash % CACHE_SHARDS];
+	std::lock_guard<std::mutex> guard(shard.lock);
+
+	auto found = shard.index.find(key);
+	if (found != shard.index.end())
+	{	Erase(shard, found->second);
+	}
+
+	while (!shard.entries.empty() && shard.bytes + cost > capacity)
+	{	Erase(shard, std::prev(shard.entries.end()));
+		evictions.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	shard.entries.push_front(RPCCacheEntry{ key.method, key.compact, str(key.params), reply, now + ttl });
+
+	// The index views the parameters held by the entry, which never move
+	auto entry = shard.entries.begin();
+	shard.index.emplace(RPCCacheKey{ entry->method, entry->compact, entry->params }, entry);
+	shard.bytes += cost;
+}
+
+
+// Drops an entry of the shard
+void RPCCache::Erase(RPCCacheShard& shard, std::list<RPCCacheEntry>::iterator entry)
+{
+	shard.index.erase(RPCCacheKey{ entry->method, entry->compact, entry->params });
+	shard.bytes -= Cost(*entry);
+	shard.entries.erase(entry);
+}
+
+
+// Returns the bytes counted for an entry
+size_t RPCCache::Cost(const RPCCacheEntry& entry)
+{	return CACHE_OVERHEAD + entry.params.size() + entry.reply.size();
+}
+
+
+// Returns the bytes counted for every cached call
+size_t RPCCache::Bytes()
+{
+	size_t bytes = 0;
+	for (int i = 0; i < CACHE_SHARDS; i++)
+	{	std::lock_guard<std::mutex> guard(shards[i].lock);
+		bytes += shards[i].bytes;
+	}
+	return bytes;
+}
+
+// Returns the number of cached calls
+size_t RPCCache::size()
+{
+	size_t count = 0;
+	for (int i = 0; i < CACHE_SHARDS; i++)
+	{	std::lock_guard<std::mutex> guard(shards[i].lock);
+		count += shards[i].entries.size();
+	}
+	return count;
+}
@@ -0,0 +1,696 @@
+#include <rpc-service/RPCClient.h>
+
+#include <condition_variable>
+
+typedef std::chrono::steady_clock clk;
+
+
+// Reply of a synchronous call, waited for on the caller's stack
+struct RPCWaiter
+{
+	std::mutex lock;				// Guards the fields below
+	std::condition_variable signal;	// Wakes the caller once the call completed
+	bool done;						// Flag of wether the call completed
+	uint flags;						// Flags of the reply, with the error flag if the call failed
+	str* reply;						// Reply of the caller
+};
+
+
+#pragma region Pool
+
+// Creates an empty pool for the endpoint
+RPCPool::RPCPool(const str _address, const int _port, const int _maxSize, const int _idleTimeout, const int _ctime)
+: address(_address), port(_port), maxSize(_maxSize < 1 ? 1 : _maxSize), idleTimeout(_idleTimeout), ctime(_ctime), zeroCopy(0), frameMax(FRAME_MAX), opening(0)
+{
+}
+
+
+// Returns the connection with the fewest calls in flight
+// Opens a new connection if every connection is busy and the pool is not full,
+// without holding the lock while connecting. Idle connections the server
+// closed are dropped rather than reused.
+// Returns NULL if no connection could be established
+std::shared_ptr<XPeer> RPCPool::Acquire(XReactor& reactor)
+{
+	std::unique_lock<std::mutex> guard(lock);
+	Connection* best = NULL;
+
+	while (true)
+	{	auto now = clk::now();
+
+		// Connections with calls in flight are left to the reactor, which
+		// fails their calls once it reads their end
+		for (size_t i = 0; i < conns.size();)
+		{	XPeer* peer = conns[i].peer.get();
+			bool idle = peer->inflight == 0 && (now - conns[i].used > std::chrono::milliseconds(idleTimeout) || peer->Stale());
+
+			if (idle)
+			{	reactor.Remove(peer);
+				conns.erase(conns.begin() + i);
+			}
+			else
+			{	i++;
+			}
+		}
+
+		best = NULL;
+		for (size_t i = 0; i < conns.size(); i++)
+		{	if (conns[i].peer->good() && (best == NULL || conns[i].peer->inflight < best->peer->inflight))
+			{	best = &conns[i];
+			}
+		}
+
+		if (best != NULL && (best->peer->inflight == 0 || (int)conns.size() + opening >= maxSize))
+		{	return best->peer;
+		}
+
+		// A full pool with no usable connection waits for the ones being opened
+		if (best == NULL && opening > 0 && (int)conns.size() + opening >= maxSize)
+		{	signal.wait(guard);
+			continue;
+		}
+
+		break;
+	}
+
+	std::shared_ptr<XPeer> fallback = best != NULL ? best->peer : NULL;
+	opening++;
+	guard.unlock();
+
+	IXSocket conn;
+	conn.Open(TCP, address, port, ctime);
+
+	std::shared_ptr<XPeer> peer = NULL;
+	if (conn.good())
+	{	if (zeroCopy > 0)
+		{	conn.ZeroCopy(zeroCopy);
+		}
+		peer = reactor.Add(conn, frameMax);
+	}
+	else
+	{	conn.Delete();
+	}
+
+	guard.lock();
+	opening--;
+	if (peer != NULL)
+	{	conns.push_back(Connection{ peer, clk::now() });
+	}
+	signal.notify_all();
+
+	return peer != NULL ? peer : fallback;
+}
+
+
+// Marks the connection as used by a completed call
+void RPCPool::Release(XPeer* peer)
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	for (size_t i = 0; i < conns.size(); i++)
+	{	if (conns[i].peer.get() == peer)
+		{	conns[i].used = clk::now();
+			break;
+		}
+	}
+}
+
+
+// Forgets a connection that was closed
+void RPCPool::Drop(XPeer* peer)
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	for (size_t i = 0; i < conns.size(); i++)
+	{	if (conns[i].peer.get() == peer)
+		{	conns.erase(conns.begin() + i);
+			break;
+		}
+	}
+}
+
+
+// Closes every connection of the pool
+// The closed connections are added to the list
+void RPCPool::Clear(XReactor& reactor, std::vector<std::shared_ptr<XPeer> >& closed)
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	for (size_t i = 0; i < conns.size(); i++)
+	{	reactor.Remove(conns[i].peer.get());
+		closed.push_back(conns[i].peer);
+	}
+
+	conns.clear();
+}
+
+
+// Completes the shared call and every identical call that waited for it
+// A successful result is cached before the call stops taking new waiters,
+// so identical calls made after find it in the cache
+void RPCPool::Land(RPCFlight* flight, uint flags, str& reply)
+{
+	RPCCacheKey key = RPCCacheKey{ flight->method, flight->compact, flight->params };
+
+	if ((flags & FRAME_ERROR) == 0 && cache != NULL)
+	{	cache->Put(key, reply, RPCClock::now());
+	}
+
+	{	std::lock_guard<std::mutex> guard(flightLock);
+		flights.erase(key);
+	}
+
+	// Every waiter but the last gets its own copy, as it may take the reply
+	size_t last = flight->waiters.size() - 1;
+	for (size_t i = 0; i < last; i++)
+	{	str copy = reply;
+		flight->waiters[i](flags, copy);
+	}
+
+	flight->waiters[last](flags, reply);
+	delete flight;
+}
+
+#pragma endregion
+
+
+#pragma region Client
+
+// Creates a client with no open connections
+// Starts the I/O thread reading the replies and expiring the calls
+RPCClient::RPCClient(int _maxSize, int _idleTimeout, int _ctime)
+: maxSize(_maxSize), idleTimeout(_idleTimeout), ctime(_ctime), zeroCopy(0), frameMax(FRAME_MAX), timeout(0), compact(false)
+, cacheTTL(0), cacheBytes(CACHE_BYTES), nextId(1), expiry(RPCClock::time_point::max()), hits(0), joined(0)
+{
+	spare.reserve(PENDING_SPARE);
+	reactor.Start(
+		[this](std::shared_ptr<XPeer> peer, std::vector<Frame>& frames) { Receive(peer, frames); },
+		[this](std::shared_ptr<XPeer> peer) { Closed(peer); },
+		[this]() { return Expire(); }
+	);
+}
+
+// Closes every connection, failing the calls in flight, and frees the pools
+RPCClient::~RPCClient()
+{
+	reactor.Stop();
+	reactor.Close();
+
+	for (auto it = pools.begin(); it != pools.end(); it++)
+	{	delete it->second;
+	}
+}
+
+
+// Returns the pool of connections to an endpoint, creating it if needed
+RPCPool* RPCClient::Pool(cstr address, int port)
+{
+	str key = str(address) + ":" + std::to_string(port);
+	std::lock_guard<std::mutex> guard(lock);
+
+	auto it = pools.find(key);
+	if (it != pools.end())
+	{	return it->second;
+	}
+
+	RPCPool* pool = new RPCPool(address, port, maxSize, idleTimeout, ctime);
+	pool->zeroCopy = zeroCopy;
+	pool->frameMax = frameMax;
+
+	if (cacheTTL > 0)
+	{	pool->cache.reset(new RPCCache(cacheBytes, std::chrono::milliseconds(cacheTTL)));
+	}
+
+	pools[key] = pool;
+	return pool;
+}
+
+
+// Shares the calls of the function
+void RPCClient::Share(str function)
+{	shared.insert(MethodId(function.c_str()));
+}
+
+
+// Closes every connection of the client
+// Calls in flight on them fail
+void RPCClient::Clear()
+{
+	std::vector<std::shared_ptr<XPeer> > closed;
+
+	{	std::lock_guard<std::mutex> guard(lock);
+		for (auto it = pools.begin(); it != pools.end(); it++)
+		{	it->second->Clear(reactor, closed);
+		}
+	}
+
+	for (size_t i = 0; i < closed.size(); i++)
+	{	Fail(closed[i].get());
+	}
+}
+
+
+// Sends the request over a pooled connection without waiting for the reply
+// The callback is called exactly once, from the client's I/O thread when
+// the reply arrives or the deadline passes, or right away if the request
+// could not be sent
+// The flags tell the server if the request starts with a function id
+void RPCClient::Send(cstr address, int port, const str& request, RPCDoneFn done, uint flags)
+{	XSlice slice = XSlice{ request.data(), request.size() };
+	Send(address, port, &slice, 1, std::move(done), flags);
+}
+
+// Sends the request made of the slices one after the other
+// The header and the slices go out in a single vectored send, with the time
+// left before the deadline as the timeout
+void RPCClient::Send(cstr address, int port, const XSlice* request, const int count, RPCDoneFn done, uint flags)
+{
+	RPCClock::time_point deadline = Deadline();
+	str none = "";
+
+	if (RPCClock::now() >= deadline)
+	{	done(FRAME_ERROR | FRAME_EXPIRED, none);
+		return;
+	}
+
+	RPCPool* pool = Pool(address, port);
+	RPCPending call = RPCPending{ NULL, pool, std::move(done), deadline };
+
+	for (int attempt = 0; ; attempt++)
+	{	std::shared_ptr<XPeer> peer = pool->Acquire(reactor);
+
+		if (peer == NULL)
+		{	call.done(FRAME_ERROR, none);
+			return;
+		}
+
+		uint id = nextId++;
+		peer->inflight++;
+		call.peer = peer;
+		Track(id, std::move(call));
+
+		FrameSlices frame;
+		MakeFrame(frame, id, flags, request, count, RPCTimeout(deadline));
+		bool unsent = false;
+		bool sent   = peer->Send(frame.slices, frame.count, &unsent);
+
+		// The connection may have been closed and the call failed already
+		if (sent || !Untrack(id, call))
+		{	return;
+		}
+		peer->inflight--;
+
+		// A connection the server closed fails before any byte of the request
+		// left, so the request is sent once more on another one
+		if (!unsent || attempt > 0)
+		{	call.done(FRAME_ERROR, none);
+			return;
+		}
+	}
+}
+
+
+// Sends a call of the function with the marshalled parameters
+// A call of a shared function that isn't cached joins an identical call in
+// flight, so it ends with that call's deadline rather than its own
+void RPCClient::Request(cstr address, int port, uint method, const str& params, RPCDoneFn done)
+{
+	MethodSlices request;
+	MakeRequest(request, method, params);
+
+	if (shared.empty() || shared.count(method) == 0)
+	{	Send(address, port, request.slices, 2, std::move(done), Flags());
+		return;
+	}
+
+	RPCPool* pool = Pool(address, port);
+	RPCCacheKey key = RPCCacheKey{ method, compact, params };
+	str reply = "";
+
+	if (pool->cache != NULL && pool->cache->Get(key, reply, RPCClock::now()))
+	{	hits++;
+		done(0, reply);
+		return;
+	}
+
+	RPCFlight* flight = NULL;
+	{	std::lock_guard<std::mutex> guard(pool->flightLock);
+
+		auto found = pool->flights.find(key);
+		if (found != pool->flights.end())
+		{	found->second->waiters.push_back(std::move(done));
+			joined++;
+			return;
+		}
+
+		// The result may have landed since the cache was looked up
+		if (pool->cache == NULL || !pool->cache->Get(key, reply, RPCClock::now()))
+		{	flight = new RPCFlight{ method, compact, params, std::vector<RPCDoneFn>() };
+			flight->waiters.push_back(std::move(done));
+			pool->flights.emplace(RPCCacheKey{ method, compact, flight->params }, flight);
+		}
+	}
+
+	if (flight == NULL)
+	{	hits++;
+		done(0, reply);
+		return;
+	}
+
+	Send(address, port, request.slices, 2, [pool, flight](uint flags, str& data)
+	{	pool->Land(flight, flags, data);
+	}, Flags());
+}
+
+
+// Sends the request over a pooled connection and waits for the reply
+// Returns false if the call failed
+bool RPCClient::Exchange(cstr address, int port, const str& request, str& reply, uint flags)
+{	XSlice slice = XSlice{ request.data(), request.size() };
+	return Exchange(address, port, &slice, 1, reply, flags);
+}
+
+// Completes a synchronous call with the reply
+// The callback only holds a pointer, so it fits in the function object
+static RPCDoneFn Notify(RPCWaiter* waiter)
+{
+	return [waiter](uint code, str& data)
+	{	std::lock_guard<std::mutex> guard(waiter->lock);
+		if ((code & FRAME_ERROR) == 0)
+		{	waiter->reply->swap(data);
+		}
+		waiter->flags = code;
+		waiter->done  = true;
+		waiter->signal.notify_one();
+	};
+}
+
+// Waits for a synchronous call to complete
+// Returns false if the call failed
+static bool Await(RPCWaiter& waiter)
+{
+	std::unique_lock<std::mutex> guard(waiter.lock);
+	waiter.signal.wait(guard, [&] { return waiter.done; });
+	return (waiter.flags & FRAME_ERROR) == 0;
+}
+
+// Sends the request made of the slices and waits for the reply
+// Returns false if the call failed
+bool RPCClient::Exchange(cstr address, int port, const XSlice* request, const int count, str& reply, uint flags)
+{
+	RPCWaiter waiter;
+	waiter.done  = false;
+	waiter.flags = FRAME_ERROR;
+	waiter.reply = &reply;
+
+	Send(address, port, request, count, Notify(&waiter), flags);
+	return Await(waiter);
+}
+
+// Sends a call of the function and waits for its result
+// Returns false if the call failed
+bool RPCClient::Exchange(cstr address, int port, uint method, const str& params, str& reply)
+{
+	RPCWaiter waiter;
+	waiter.done  = false;
+	waiter.flags = FRAME_ERROR;
+	waiter.reply = &reply;
+
+	Request(address, port, method, params, Notify(&waiter));
+	return Await(waiter);
+}
+
+
+// Returns the deadline of a call made now
+// Calls made while a function of a service runs end no later than it does
+RPCClock::time_point RPCClient::Deadline()
+{	return RPCCallDeadline(timeout);
+}
+
+
+// Adds a request in flight
+// Reuses the node of a completed request so the map doesn't allocate
+// Wakes the I/O thread if the request has the earliest deadline, so it
+// expires the request in time
+void RPCClient::Track(uint id, RPCPending call)
+{
+	bool sooner = false;
+
+	{	std::lock_guard<std::mutex> guard(pendingLock);
+		if (call.deadline < expiry)
+		{	expiry = call.deadline;
+			sooner = true;
+		}
+
+		if (spare.empty())
+		{	pending.emplace(id, std::move(call));
+		}
+		else
+		{	auto node = std::move(spare.back());
+			spare.pop_back();
+
+			node.key()    = id;
+			node.mapped() = std::move(call);
+			pending.insert(std::move(node));
+		}
+	}
+
+	if (sooner)
+	{	reactor.Wake();
+	}
+}
+
+// Takes a request off the requests in flight
+// Keeps its node for the next request
+// Returns false if the request is not in flight
+bool RPCClient::Untrack(uint id, RPCPending& call)
+{
+	std::lock_guard<std::mutex> guard(pendingLock);
+
+	auto it = pending.find(id);
+	if (it == pending.end())
+	{	return false;
+	}
+
+	auto node = pending.extract(it);
+	call = std::move(node.mapped());
+	node.mapped() = RPCPending();
+
+	if (spare.size() < PENDING_SPARE)
+	{	spare.push_back(std::move(node));
+	}
+
+	return true;
+}
+
+
+// Fails the requests in flight whose deadline passed, from the I/O thread
+// Replies arriving afterwards match no request and are dropped
+// Returns the milliseconds until the next deadline, or -1 if no request has one
+int RPCClient::Expire()
+{
+	std::vector<RPCPending> expired;
+	RPCClock::time_point now  = RPCClock::now();
+	RPCClock::time_point next = RPCClock::time_point::max();
+
+	{	std::lock_guard<std::mutex> guard(pendingLock);
+		if (now < expiry)
+		{	next = expiry;
+		}
+		else
+		{	for (auto it = pending.begin(); it != pending.end();)
+			{	if (it->second.deadline <= now)
+				{	expired.push_back(std::move(it->second));
+					it = pending.erase(it);
+				}
+				else
+				{	next = std::min(next, it->second.deadline);
+					it++;
+				}
+			}
+			expiry = next;
+		}
+	}
+
+	str none = "";
+	for (size_t i = 0; i < expired.size(); i++)
+	{	expired[i].peer->inflight--;
+		expired[i].done(FRAME_ERROR | FRAME_EXPIRED, none);
+	}
+
+	if (next == RPCClock::time_point::max())
+	{	return -1;
+	}
+	return (int)std::chrono::ceil<std::chrono::milliseconds>(next - now).count();
+}
+
+
+// Completes the calls whose replies arrived on a connection
+// Replies are matched to their request by id
+void RPCClient::Receive(std::shared_ptr<XPeer> peer, std::vector<Frame>& frames)
+{
+	for (size_t i = 0; i < frames.size(); i++)
+	{
+		RPCPending call;
+		if (Untrack(frames[i].header.id, call))
+		{	peer->inflight--;
+			call.pool->Release(peer.get());
+			call.done(frames[i].header.flags, frames[i].payload);
+		}
+
+		Buffers().Release(frames[i].payload);
+	}
+}
+
+
+// Forgets a connection that was closed and fails its calls in flight
+void RPCClient::Closed(std::shared_ptr<XPeer> peer)
+{
+	{	std::lock_guard<std::mutex> guard(lock);
+		for (auto it = pools.begin(); it != pools.end(); it++)
+		{	it->second->Drop(peer.get());
+		}
+	}
+
+	Fail(peer.get());
+}
+
+
+// Fails every call in flight on the connection
+void RPCClient::Fail(XPeer* peer)
+{
+	std::vector<RPCPending> failed;
+
+	{	std::lock_guard<std::mutex> guard(pendingLock);
+		for (auto it = pending.begin(); it != pending.end();)
+		{	if (it->second.peer.get() == peer)
+			{	failed.push_back(std::move(it->second));
+				it = pending.erase(it);
+			}
+			else
+			{	it++;
+			}
+		}
+	}
+
+	str none = "";
+	for (size_t i = 0; i < failed.size(); i++)
+	{	failed[i].peer->inflight--;
+		failed[i].done(FRAME_ERROR, none);
+	}
+}
+
+
+// Returns an empty batch of calls to the endpoint
+// Calls added to the batch are sent together in one frame
+RPCBatch RPCClient::Batch(cstr address, int port)
+{	return RPCBatch(this, address, port);
+}
+
+#pragma endregion
+
+
+#pragma region Batch
+
+// Creates an empty batch of calls to the endpoint
+RPCBatch::RPCBatch(RPCClient* _client, cstr _address, int _port)
+: client(_client), address(_address), port(_port), count(0), parallel(false), compact(_client->compact)
+{	calls = Buffers().Acquire(PACKAGE_SIZE);
+}
+
+// Returns the payload of the batch to the pool
+RPCBatch::~RPCBatch()
+{	Buffers().Release(calls);
+}
+
+
+// Lets the server run the calls of the batch at the same time
+RPCBatch& RPCBatch::Parallel(bool enabled)
+{
+	parallel = enabled;
+	return *this;
+}
+
+// Returns the flags of the batch's frame
+uint RPCBatch::Flags()
+{	return FRAME_BATCH | FRAME_METHOD | (parallel ? FRAME_PARALLEL : 0) | (compact ? FRAME_COMPACT : 0);
+}
+
+
+// Sends the calls in one frame and waits for their replies
+// The replies are not ok if the batch failed as a whole
+RPCReplies RPCBatch::Send()
+{
+	RPCReplies replies;
+	replies.compact = compact;
+
+	replies.ok = client->Exchange(address.c_str(), port, calls, replies.data, Flags())
+		&& replies.Parse() && replies.size() == count;
+
+	return replies;
+}
+
+// Sends the calls in one frame without waiting
+// Returns a handle to the replies, completed from the client's I/O thread
+RPCTask<RPCReplies> RPCBatch::Async()
+{
+	RPCTask<RPCReplies> task;
+	auto   state = task.state;
+	size_t calls = count;
+	bool encoding = compact;
+
+	client->Send(address.c_str(), port, this->calls, [state, calls, encoding](uint flags, str& reply)
+	{	RPCResult<RPCReplies> result = RPCResult<RPCReplies>();
+		result.value.compact = encoding;
+		result.value.data.swap(reply);
+		result.value.ok = (flags & FRAME_ERROR) == 0 && result.value.Parse() && result.value.size() == calls;
+		result.ok = result.value.ok;
+		result.expired = (flags & FRAME_EXPIRED) != 0;
+		result.overloaded = (flags & FRAME_OVERLOADED) != 0;
+		state->Complete(std::move(result));
+	}, Flags());
+
+	return task;
+}
+
+#pragma endregion
+
+
+#pragma region Replies
+
+// Reads the results of the calls out of the payload
+// Returns false if the payload is cut short
+bool RPCReplies::Parse()
+{
+	std::string_view batch = data;
+	std::string_view reply;
+	uint flags = 0;
+
+	replies.clear();
+	while (NextReply(batch, flags, reply))
+	{	replies.push_back(RPCReply{ (size_t)(reply.data() - data.data()), reply.size(), flags });
+	}
+
+	return batch.empty();
+}
+
+// Returns the number of results
+size_t RPCReplies::size()
+{	return replies.size();
+}
+
+// Returns true if the call at the index succeeded
+bool RPCReplies::good(size_t index)
+{	return ok && index < replies.size() && (replies[index].flags & FRAME_ERROR) == 0;
+}
+
+#pragma endregion
+
+
+// Client shared by the asynchronous calls made without a client
+// Created on first use and kept for the lifetime of the program
+RPCClient& DefaultClient()
+{
+	static RPCClient client;
+	return client;
+}
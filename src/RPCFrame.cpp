@@ -0,0 +1,285 @@
+#include <rpc-service/RPCFrame.h>
+
+#include <algorithm>
+#include <string.h>
+
+// Writes an integer as 4 little-endian bytes
+static void writeUint(char* buffer, uint value)
+{
+	buffer[0] = (char)(value);
+	buffer[1] = (char)(value >> 8);
+	buffer[2] = (char)(value >> 16);
+	buffer[3] = (char)(value >> 24);
+}
+
+// Reads an integer from 4 little-endian bytes
+static uint readUint(cstr buffer)
+{
+	const byte* b = (const byte*)buffer;
+	return (uint)b[0] | ((uint)b[1] << 8) | ((uint)b[2] << 16) | ((uint)b[3] << 24);
+}
+
+
+// Writes the header into the first FRAME_HEADER bytes of the buffer
+void WriteHeader(char* buffer, const FrameHeader header)
+{
+	writeUint(buffer,      header.length);
+	writeUint(buffer + 4,  header.id);
+	writeUint(buffer + 8,  header.flags);
+	writeUint(buffer + 12, header.timeout);
+}
+
+// Reads the header from the first FRAME_HEADER bytes of the buffer
+FrameHeader ReadHeader(cstr buffer)
+{
+	FrameHeader header;
+	header.length  = readUint(buffer);
+	header.id      = readUint(buffer + 4);
+	header.flags   = readUint(buffer + 8);
+	header.timeout = readUint(buffer + 12);
+	return header;
+}
+
+
+// Builds a complete frame of a header followed by the payload
+// The frame is taken from the pool with its final size
+str MakeFrame(const uint id, const uint flags, const str& payload)
+{
+	char header[FRAME_HEADER];
+	WriteHeader(header, FrameHeader{ (uint)payload.size(), id, flags, 0 });
+
+	str frame = Buffers().Acquire(FRAME_HEADER + payload.size());
+	frame.append(header, FRAME_HEADER);
+	frame.append(payload);
+	return frame;
+}
+
+// Sends a complete frame through the socket
+// The header and the payload go out in a single vectored send
+// Returns true if the frame was sent successfully
+bool SendFrame(IXSocket conn, const uint id, const uint flags, const str& payload)
+{
+	FrameSlices frame;
+	XSlice slice = XSlice{ payload.data(), payload.size() };
+
+	MakeFrame(frame, id, flags, &slice, 1);
+	conn.Send(frame.slices, frame.count);
+	return conn.good();
+}
+
+// Sends a complete frame whose payload is the slices one after the other
+// Returns true if the frame was sent successfully
+bool SendFrame(IXSocket conn, const uint id, const uint flags, const XSlice* payload, const int count, const uint timeout)
+{
+	FrameSlices frame;
+
+	MakeFrame(frame, id, flags, payload, count, timeout);
+	conn.Send(frame.slices, frame.count);
+	return conn.good();
+}
+
+
+// Describes a frame whose payload is the slices one after the other
+// Slices past FRAME_SLICES are left out
+void MakeFrame(FrameSlices& frame, const uint id, const uint flags, const XSlice* payload, const int count, const uint timeout)
+{
+	size_t length = 0;
+	int    used   = count < FRAME_SLICES ? count : FRAME_SLICES;
+
+	for (int i = 0; i < used; i++)
+	{	frame.slices[i + 1] = payload[i];
+		length += payload[i].size;
+	}
+
+	WriteHeader(frame.header, FrameHeader{ (uint)length, id, flags, timeout });
+	frame.slices[0] = XSlice{ frame.header, FRAME_HEADER };
+	frame.count = used + 1;
+}
+
+// Blocks the thread until a complete frame is received
+// The payload grows as its bytes arrive, doubling the bytes read at once, so
+// a header announcing a large frame doesn't allocate it before it's sent
+// Returns false if the connection failed or the payload is larger than max
+bool RecvFrame(IXSocket conn, FrameHeader& header, str& payload, const size_t max)
+{
+	char buffer[FRAME_HEADER];
+
+	if (!conn.Read(buffer, FRAME_HEADER))
+	{	return false;
+	}
+
+	header = ReadHeader(buffer);
+	if (header.length > max)
+	{	conn.Close();
+		return false;
+	}
+
+	payload.clear();
+	while (payload.size() < header.length)
+	{	size_t have  = payload.size();
+		size_t chunk = std::min<size_t>(header.length - have, std::max<size_t>(have, FRAME_CHUNK));
+
+		Buffers().Grow(payload, have + chunk);
+		payload.resize(have + chunk);
+		if (!conn.Read(&payload[have], (int)chunk))
+		{	return false;
+		}
+	}
+
+	return true;
+}
+
+
+// Writes the id of a function as 4 little-endian bytes
+void WriteMethod(char* buffer, const uint method)
+{	writeUint(buffer, method);
+}
+
+// Builds the payload of a request calling a function by its id
+// The id is written as 4 little-endian bytes in front of the parameters
+str MethodRequest(const uint method, const str& params)
+{
+	char id[METHOD_SIZE];
+	writeUint(id, method);
+
+	str request = Buffers().Acquire(METHOD_SIZE + params.size());
+	request.append(id, METHOD_SIZE);
+	request.append(params);
+	return request;
+}
+
+// Reads the id of the function from the start of a request's payload
+uint ReadMethod(cstr payload)
+{	return readUint(payload);
+}
+
+// Describes a request calling a function by its id without copying the parameters
+void MakeRequest(MethodSlices& request, const uint method, const str& params)
+{
+	writeUint(request.id, method);
+	request.slices[0] = XSlice{ request.id, METHOD_SIZE };
+	request.slices[1] = XSlice{ params.data(), params.size() };
+}
+
+
+// Appends a call of a function by its id to the payload of a batch
+// Every call is its length followed by the id and the parameters
+void AppendCall(str& batch, const uint method, const str& params)
+{
+	char head[BATCH_CALL + METHOD_SIZE];
+	writeUint(head, (uint)(METHOD_SIZE + params.size()));
+	writeUint(head + BATCH_CALL, method);
+
+	Buffers().Grow(batch, batch.size() + sizeof(head) + params.size());
+	batch.append(head, sizeof(head));
+	batch.append(params);
+}
+
+// Appends the reply of a call to the payload of a batch's reply
+// Every reply is its length and flags followed by the result
+void AppendReply(str& batch, const uint flags, std::string_view reply)
+{
+	char head[BATCH_REPLY];
+	writeUint(head, (uint)reply.size());
+	writeUint(head + 4, flags);
+
+	Buffers().Grow(batch, batch.size() + sizeof(head) + reply.size());
+	batch.append(head, sizeof(head));
+	batch.append(reply);
+}
+
+// Takes the next call off the front of a batch
+// Returns false at the end of the batch, or if the call is cut short
+bool NextCall(std::string_view& batch, std::string_view& call)
+{
+	if (batch.size() < BATCH_CALL)
+	{	return false;
+	}
+
+	uint length = readUint(batch.data());
+	if (batch.size() - BATCH_CALL < length)
+	{	return false;
+	}
+
+	call  = batch.substr(BATCH_CALL, length);
+	batch = batch.substr(BATCH_CALL + length);
+	return true;
+}
+
+// Takes the next reply off the front of a batch's reply
+// Returns false at the end of the reply, or if the reply is cut short
+bool NextReply(std::string_view& batch, uint& flags, std::string_view& reply)
+{
+	if (batch.size() < BATCH_REPLY)
+	{	return false;
+	}
+
+	uint length = readUint(batch.data());
+	if (batch.size() - BATCH_REPLY < length)
+	{	return false;
+	}
+
+	flags = readUint(batch.data() + 4);
+	reply = batch.substr(BATCH_REPLY, length);
+	batch = batch.substr(BATCH_REPLY + length);
+	return true;
+}
+
+
+// Creates a decoder with no pending bytes accepting payloads of up to max bytes
+FrameDecoder::FrameDecoder(const size_t _max) : offset(0), max(_max), failed(false) {}
+
+// Appends bytes read from the connection
+// Decoded frames are dropped from the front of the buffer first, and the
+// buffer only grows to hold the bytes received
+void FrameDecoder::Feed(cstr data, const size_t size)
+{
+	if (offset > 0)
+	{	buffer.erase(0, offset);
+		offset = 0;
+	}
+
+	Buffers().Grow(buffer, buffer.size() + size);
+	buffer.append(data, size);
+}
+
+// Takes the next complete frame from the buffer
+// Returns false if there is no complete frame yet, or the stream is invalid
+bool FrameDecoder::Next(Frame& frame)
+{
+	if (failed || buffer.size() - offset < FRAME_HEADER)
+	{	return false;
+	}
+
+	FrameHeader header = ReadHeader(buffer.data() + offset);
+	if (header.length > max)
+	{	failed = true;
+		return false;
+	}
+
+	if (buffer.size() - offset - FRAME_HEADER < header.length)
+	{	return false;
+	}
+
+	frame.header = header;
+
+	// A buffer holding exactly one frame is handed over instead of copied
+	if (offset == 0 && buffer.size() == FRAME_HEADER + header.length)
+	{	Buffers().Release(frame.payload);
+		frame.payload.swap(buffer);
+		frame.payload.erase(0, FRAME_HEADER);
+		return true;
+	}
+
+	Buffers().Release(frame.payload);
+	frame.payload = Buffers().Acquire(header.length);
+	frame.payload.append(buffer, offset + FRAME_HEADER, header.length);
+	offset += FRAME_HEADER + header.length;
+
+	if (offset == buffer.size())
+	{	buffer.clear();
+		offset = 0;
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include <rpc-service/RPCLimiter.h>
+
+#include <algorithm>
+
+// Creates a limiter admitting up to ceiling requests at once
+// With a target latency, the limit adapts between the floor and the ceiling,
+// starting from the ceiling
+RPCLimiter::RPCLimiter(size_t _ceiling, RPCClock::duration _target, size_t _floor)
+: inflight(0), limit((double)_ceiling), lowered(0), rejected(0)
+, floor(std::max<size_t>(1, std::min(_floor, _ceiling))), ceiling(_ceiling), target(_target)
+{
+}
+
+
+// Admits a request if fewer requests than the limit are in flight
+// Returns false if the request is rejected, in which case it's not released
+bool RPCLimiter::Acquire()
+{
+	size_t count = inflight.fetch_add(1, std::memory_order_relaxed) + 1;
+	if ((double)count <= limit.load(std::memory_order_relaxed))
+	{	return true;
+	}
+
+	inflight.fetch_sub(1, std::memory_order_relaxed);
+	rejected.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+
+// Releases an admitted request along with the time it took
+// Adapts the limit to the latency if the limiter has a target
+void RPCLimiter::Release(RPCClock::duration latency)
+{
+	size_t count = inflight.fetch_sub(1, std::memory_order_relaxed);
+	if (target == RPCClock::duration::zero())
+	{	return;
+	}
+
+	double current = limit.load(std::memory_order_relaxed);
+
+	// Slow requests completing together only lower the limit once
+	if (latency > target)
+	{	RPCClock::rep now  = RPCClock::now().time_since_epoch().count();
+		RPCClock::rep last = lowered.load(std::memory_order_relaxed);
+
+		if (now - last >= target.count() && lowered.compare_exchange_strong(last, now, std::memory_order_relaxed))
+		{	limit.store(std::max((double)floor, current * LIMIT_BACKOFF), std::memory_order_relaxed);
+		}
+		return;
+	}
+
+	// The limit only grows while requests come close to it
+	while (current < (double)ceiling && (double)count * 2 >= current)
+	{	double next = std::min((double)ceiling, current + 1.0 / current);
+		if (limit.compare_exchange_weak(current, next, std::memory_order_relaxed))
+		{	break;
+		}
+	}
+}
+
+
+// Releases an admitted request that was rejected elsewhere
+// The limit is left as it is, since the request never ran
+void RPCLimiter::Cancel()
+{	inflight.fetch_sub(1, std::memory_order_relaxed);
+}
+
+
+// Returns the number of requests currently admitted at once
+size_t RPCLimiter::Limit()
+{	return (size_t)limit.load(std::memory_order_relaxed);
+}
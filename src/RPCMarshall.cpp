@@ -0,0 +1,160 @@
+#include <rpc-service/RPCMarshall.h>
+
+// Breaks down data types into Byte arrays
+// Byte arrays can be sent through the network
+// Strings are sent without their terminator
+str Marshall(cstr raw)             { return str(raw); }
+str Marshall(str  raw)             { return raw; }
+str Marshall(std::string_view raw) { return str(raw); }
+
+
+#pragma region Byte Order
+
+// Reverses the bytes of each number of a given width
+template<class T>
+static void swapEach(char* data, const size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{	T value;
+		std::memcpy(&value, data + i * sizeof(T), sizeof(T));
+		value = ByteSwap(value);
+		std::memcpy(data + i * sizeof(T), &value, sizeof(T));
+	}
+}
+
+// Reverses the bytes of each of count numbers of width bytes in place
+// Converts arrays of numbers between the wire's byte order and a big-endian
+// host's. The loop of each width is simple enough for the compiler to turn
+// into vector byte shuffles.
+void SwapBytes(char* data, const size_t count, const size_t width)
+{
+	switch (width)
+	{
+	case 2:  swapEach<unsigned short>(data, count);     break;
+	case 4:  swapEach<unsigned int>(data, count);       break;
+	case 8:  swapEach<unsigned long long>(data, count); break;
+	default:
+		for (size_t i = 0; i < count; i++)
+		{	std::reverse(data + i * width, data + (i + 1) * width);
+		}
+	}
+}
+
+#pragma endregion
+
+
+#pragma region Compact Encoding
+
+// Appends an unsigned integer in groups of 7 bits, lowest first
+// Every byte but the last has its highest bit set
+void WriteVarint(str& out, unsigned long long value)
+{
+	char bytes[10];
+	int  size = 0;
+
+	while (value >= 0x80)
+	{	bytes[size++] = (char)(value | 0x80);
+		value >>= 7;
+	}
+	bytes[size++] = (char)value;
+
+	out.append(bytes, size);
+}
+
+// Appends a string prefixed with its length
+void Encode(str& out, cstr value)
+{	Encode(out, std::string_view(value));
+}
+
+void Encode(str& out, const str& value)
+{	Encode(out, std::string_view(value));
+}
+
+void Encode(str& out, std::string_view value)
+{	WriteVarint(out, value.size());
+	Buffers().Grow(out, out.size() + value.size());
+	out.append(value.data(), value.size());
+}
+
+// Reads a string prefixed with its length
+str Decode(RPCReader& reader, Type<str>)
+{	return str(Decode(reader, Type<std::string_view>()));
+}
+
+std::string_view Decode(RPCReader& reader, Type<std::string_view>)
+{	size_t size  = reader.Count();
+	cstr   bytes = reader.Take(size);
+	return bytes != NULL ? std::string_view(bytes, size) : std::string_view();
+}
+
+#pragma endregion
+
+
+#pragma region Raw Encoding
+
+// Takes the rest of the payload as a string
+str Unmarshall(RPCReader& reader, Type<str>)
+{	return str(Unmarshall(reader, Type<std::string_view>()));
+}
+
+std::string_view Unmarshall(RPCReader& reader, Type<std::string_view>)
+{	std::string_view rest(reader.cursor, reader.end - reader.cursor);
+	reader.cursor = reader.end;
+	return rest;
+}
+
+#pragma endregion
+
+
+#pragma region Reader
+
+// Returns the next size bytes and moves past them
+// Returns NULL and fails the reader if fewer bytes are left
+cstr RPCReader::Take(const size_t size)
+{
+	if ((size_t)(end - cursor) < size)
+	{	ok = false;
+		cursor = end;
+		return NULL;
+	}
+
+	cstr bytes = cursor;
+	cursor += size;
+	return bytes;
+}
+
+// Returns the next varint, or 0 and fails the reader if it is cut short
+unsigned long long RPCReader::Varint()
+{
+	unsigned long long value = 0;
+
+	for (int shift = 0; shift < 64 && cursor < end; shift += 7)
+	{	byte next = (byte)*cursor++;
+		value |= (unsigned long long)(next & 0x7F) << shift;
+
+		if ((next & 0x80) == 0)
+		{	return value;
+		}
+	}
+
+	ok = false;
+	cursor = end;
+	return 0;
+}
+
+// Returns the number of items of a string or a container
+// Every item takes at least a byte, so a count larger than the bytes left
+// returns 0 and fails the reader rather than reserving memory for it
+size_t RPCReader::Count()
+{
+	unsigned long long count = Varint();
+
+	if (count > (unsigned long long)(end - cursor))
+	{	ok = false;
+		cursor = end;
+		return 0;
+	}
+	return (size_t)count;
+}
+
+#pragma endregion
@@ -1,72 +1,102 @@
 #include <rpc-service/RPCService.h>
 
-// Breaks down data types into Byte arrays
-// Byte arrays can be sent through the network
-str Marshall(char      raw) { return str((char*)&raw, sizeof(raw)); }
-str Marshall(short     raw) { return str((char*)&raw, sizeof(raw)); }
-str Marshall(int       raw) { return str((char*)&raw, sizeof(raw)); }
-str Marshall(long      raw) { return str((char*)&raw, sizeof(raw)); }
-str Marshall(long long raw) { return str((char*)&raw, sizeof(raw)); }
-str Marshall(float     raw) { return str((char*)&raw, sizeof(raw)); }
-str Marshall(double    raw) { return str((char*)&raw, sizeof(raw)); }
-str Marshall(cstr      raw) { return str(raw, sizeof(raw)); }
-str Marshall(str       raw) { return raw; }
-
-
-// Casts data from Byte arrays into the specified data type
-// Assigns the number of bytes consumed in size if pointer is not null
-char Unmarshall(cstr data, int* size, Type<char>)
-{ 
-	if (size != NULL)
-	{	*size = 1;
-	}
-	return *(char*)data; 
+// Creates an empty registry
+RPCRegistry::RPCRegistry() : nextKey(1), count(0)
+{
 }
 
-short Unmarshall(cstr data, int* size, Type<short>)
-{ 
-	if (size != NULL)
-	{	*size = 2; 
-	}
-	return *(short*)data; 
+
+// Returns the shard holding the key
+// Keys are handed out in order, so consecutive requests land in different shards
+RPCShard& RPCRegistry::Shard(unsigned long long key)
+{	return shards[key % REGISTRY_SHARDS];
 }
 
-int Unmarshall(cstr data, int* size, Type<int>) 
-{ 
-	if (size != NULL) 
-	{	*size = 4; 
-	}
-	return *(int*)data; 
+
+// Registers the request and returns its key
+unsigned long long RPCRegistry::Add(const Request& request)
+{
+	unsigned long long key = nextKey++;
+	RPCShard& shard = Shard(key);
+
+	std::lock_guard<std::mutex> guard(shard.lock);
+	shard.entries.emplace(key, request);
+	count++;
+	return key;
 }
 
-long Unmarshall(cstr data, int* size, Type<long>)
-{ 
-	if (size != NULL) 
-	{	*size = 8; 
+
+// Sets the thread serving the request
+// Returns false if the request was already removed, leaving the thread to the caller
+bool RPCRegistry::Attach(unsigned long long key, void* thread)
+{
+	RPCShard& shard = Shard(key);
+	std::lock_guard<std::mutex> guard(shard.lock);
+
+	auto found = shard.entries.find(key);
+	if (found == shard.entries.end())
+	{	return false;
 	}
-	return *(long*)data; 
+
+	found->second.thread = thread;
+	return true;
 }
 
-long long Unmarshall(cstr data, int* size, Type<long long>)
+
+// Takes the request out of the registry
+// Returns false if it was already removed
+bool RPCRegistry::Remove(unsigned long long key, Request& removed)
 {
-	if (size != NULL)
-	{	*size = 8;
+	RPCShard& shard = Shard(key);
+	std::lock_guard<std::mutex> guard(shard.lock);
+
+	auto found = shard.entries.find(key);
+	if (found == shard.entries.end())
+	{	return false;
 	}
-	return *(long long*)data;
+
+	removed = found->second;
+	shard.entries.erase(found);
+	count--;
+	return true;
 }
 
-float Unmarshall(cstr data, int* size, Type<float>)
-{ 
-	if (size != NULL) 
-	{	*size = 8; 
+
+// Takes every request out of the registry and returns them
+std::vector<Request> RPCRegistry::Clear()
+{
+	std::vector<Request> removed;
+	for (int i = 0; i < REGISTRY_SHARDS; i++)
+	{	std::lock_guard<std::mutex> guard(shards[i].lock);
+
+		for (auto& entry : shards[i].entries)
+		{	removed.push_back(entry.second);
+		}
+
+		count -= shards[i].entries.size();
+		shards[i].entries.clear();
 	}
-	return *(float*)data; 
+	return removed;
 }
 
-double Unmarshall(cstr data, int* size, Type<double>)
-{ 
-	if (size != NULL) 
-	{	*size = 8; 
+
+// Stops receiving on the socket of every request
+// Threads waiting for a new request see their connection end, while threads
+// completing one can still send the reply. The sockets stay valid as the
+// shard is locked against the threads removing them.
+void RPCRegistry::Shutdown()
+{
+	for (int i = 0; i < REGISTRY_SHARDS; i++)
+	{	std::lock_guard<std::mutex> guard(shards[i].lock);
+
+		for (auto& entry : shards[i].entries)
+		{	entry.second.client.Shutdown();
+		}
 	}
-	return *(double*)data; 
-}
\ No newline at end of file
+}
+
+
+// Returns the number of requests registered
+size_t RPCRegistry::size()
+{	return count;
+}
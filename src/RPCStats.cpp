@@ -0,0 +1,322 @@
+#include <rpc-service/RPCStats.h>
+
+#include <bit>
+#include <cmath>
+
+
+#pragma region Histogram
+
+// Creates an empty histogram
+RPCHistogram::RPCHistogram() : count(0), total(0), buckets(STATS_BUCKETS, 0)
+{
+}
+
+
+// Returns the bucket of a latency
+// Latencies below STATS_SUB nanoseconds have a bucket each, larger ones are
+// split by their highest bit and the STATS_SUB_BITS bits below it
+size_t RPCHistogram::Bucket(unsigned long long ns)
+{
+	if (ns < STATS_SUB)
+	{	return (size_t)ns;
+	}
+
+	int    high  = std::bit_width(ns) - 1;
+	size_t group = (size_t)(high - STATS_SUB_BITS + 1);
+	size_t step  = (size_t)(ns >> (high - STATS_SUB_BITS)) & (STATS_SUB - 1);
+	size_t index = group * STATS_SUB + step;
+
+	return index < STATS_BUCKETS ? index : STATS_BUCKETS - 1;
+}
+
+
+// Returns the smallest latency held by the bucket
+unsigned long long RPCHistogram::Lower(size_t bucket)
+{
+	if (bucket < STATS_SUB)
+	{	return bucket;
+	}
+
+	size_t group = bucket / STATS_SUB;
+	size_t step  = bucket % STATS_SUB;
+	return (unsigned long long)(STATS_SUB + step) << (group - 1);
+}
+
+
+// Returns the largest latency held by the bucket
+unsigned long long RPCHistogram::Upper(size_t bucket)
+{	return Lower(bucket + 1) - 1;
+}
+
+
+// Returns the mean latency in nanoseconds
+double RPCHistogram::Mean() const
+{	return count > 0 ? (double)total / count : 0;
+}
+
+
+// Returns the latency below which the percentile of the latencies fall
+// The latency is the largest one of its bucket
+unsigned long long RPCHistogram::Percentile(double percentile) const
+{
+	if (count == 0)
+	{	return 0;
+	}
+
+	unsigned long long rank = (unsigned long long)std::ceil(count * percentile / 100.0);
+	unsigned long long seen = 0;
+	rank = rank < 1 ? 1 : rank;
+
+	for (size_t i = 0; i < buckets.size(); i++)
+	{	seen += buckets[i];
+		if (seen >= rank)
+		{	return Upper(i);
+		}
+	}
+	return Max();
+}
+
+
+// Returns the largest latency recorded, to the precision of its bucket
+unsigned long long RPCHistogram::Max() const
+{
+	for (size_t i = buckets.size(); i-- > 0;)
+	{	if (buckets[i] != 0)
+		{	return Upper(i);
+		}
+	}
+	return 0;
+}
+
+#pragma endregion
+
+
+#pragma region Counters
+
+// Creates counters with every count at zero
+RPCStats::RPCStats()
+{
+	for (int s = 0; s < STATS_SHARDS; s++)
+	{	RPCStatShard& shard = shards[s];
+		shard.calls      = 0;
+		shard.errors     = 0;
+		shard.expired    = 0;
+		shard.overloaded = 0;
+		shard.hits       = 0;
+		shard.misses     = 0;
+		shard.bytesIn    = 0;
+		shard.bytesOut   = 0;
+
+		for (int p = 0; p < STATS_PHASES; p++)
+		{	shard.total[p] = 0;
+			for (int b = 0; b < STATS_BUCKETS; b++)
+			{	shard.buckets[p][b] = 0;
+			}
+		}
+	}
+}
+
+
+// Returns the shard of the calling thread
+// Threads are spread over the shards in the order they first record a call
+RPCStatShard& RPCStats::Shard()
+{
+	static std::atomic<size_t> nextShard(0);
+	thread_local size_t index = nextShard++ % STATS_SHARDS;
+	return shards[index];
+}
+
+
+// Records a call with the sizes of its request and reply
+// A failed call only counts its decoding time, as the function never ran
+void RPCStats::Call(bool ok, size_t bytesIn, size_t bytesOut, unsigned long long decode, unsigned long long execute)
+{
+	RPCStatShard& shard = Shard();
+	shard.calls.fetch_add(1, std::memory_order_relaxed);
+	shard.bytesIn.fetch_add(bytesIn, std::memory_order_relaxed);
+	shard.bytesOut.fetch_add(bytesOut, std::memory_order_relaxed);
+
+	shard.total[STATS_DECODE].fetch_add(decode, std::memory_order_relaxed);
+	shard.buckets[STATS_DECODE][RPCHistogram::Bucket(decode)].fetch_add(1, std::memory_order_relaxed);
+
+	if (!ok)
+	{	shard.errors.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	shard.total[STATS_EXECUTE].fetch_add(execute, std::memory_order_relaxed);
+	shard.buckets[STATS_EXECUTE][RPCHistogram::Bucket(execute)].fetch_add(1, std::memory_order_relaxed);
+}
+
+
+// Records the latency of a phase of a call
+void RPCStats::Record(int phase, unsigned long long ns)
+{
+	RPCStatShard& shard = Shard();
+	shard.total[phase].fetch_add(ns, std::memory_order_relaxed);
+	shard.buckets[phase][RPCHistogram::Bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+}
+
+
+// Records a call dropped without running as its deadline passed
+// It's counted as failed, with no latency as none of its phases ran
+void RPCStats::Expire(size_t bytesIn)
+{
+	RPCStatShard& shard = Shard();
+	shard.calls.fetch_add(1, std::memory_order_relaxed);
+	shard.errors.fetch_add(1, std::memory_order_relaxed);
+	shard.expired.fetch_add(1, std::memory_order_relaxed);
+	shard.bytesIn.fetch_add(bytesIn, std::memory_order_relaxed);
+}
+
+
+// Records a call rejected without running as the service was overloaded
+// It's counted as failed, with no latency as none of its phases ran
+void RPCStats::Reject(size_t bytesIn)
+{
+	RPCStatShard& shard = Shard();
+	shard.calls.fetch_add(1, std::memory_order_relaxed);
+	shard.errors.fetch_add(1, std::memory_order_relaxed);
+	shard.overloaded.fetch_add(1, std::memory_order_relaxed);
+	shard.bytesIn.fetch_add(bytesIn, std::memory_order_relaxed);
+}
+
+
+// Records a call answered from the cache with the sizes of its request and reply
+// It has no decoding or execution latency, as the function never ran
+void RPCStats::Hit(size_t bytesIn, size_t bytesOut)
+{
+	RPCStatShard& shard = Shard();
+	shard.calls.fetch_add(1, std::memory_order_relaxed);
+	shard.hits.fetch_add(1, std::memory_order_relaxed);
+	shard.bytesIn.fetch_add(bytesIn, std::memory_order_relaxed);
+	shard.bytesOut.fetch_add(bytesOut, std::memory_order_relaxed);
+}
+
+// Records a call of a cacheable function whose reply wasn't cached
+// The call itself is recorded once the function ran
+void RPCStats::Miss()
+{	Shard().misses.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+// Adds up the shards into a snapshot of the function's counters
+// Calls recorded meanwhile may be partly counted
+RPCProcedureStats RPCStats::Snapshot(const str& name)
+{
+	RPCProcedureStats stats = RPCProcedureStats{};
+	stats.name = name;
+
+	for (int s = 0; s < STATS_SHARDS; s++)
+	{	RPCStatShard& shard = shards[s];
+		stats.calls      += shard.calls.load(std::memory_order_relaxed);
+		stats.errors     += shard.errors.load(std::memory_order_relaxed);
+		stats.expired    += shard.expired.load(std::memory_order_relaxed);
+		stats.overloaded += shard.overloaded.load(std::memory_order_relaxed);
+		stats.hits       += shard.hits.load(std::memory_order_relaxed);
+		stats.misses     += shard.misses.load(std::memory_order_relaxed);
+		stats.bytesIn    += shard.bytesIn.load(std::memory_order_relaxed);
+		stats.bytesOut   += shard.bytesOut.load(std::memory_order_relaxed);
+
+		for (int p = 0; p < STATS_PHASES; p++)
+		{	RPCHistogram& phase = stats.phases[p];
+			phase.total += shard.total[p].load(std::memory_order_relaxed);
+
+			for (int b = 0; b < STATS_BUCKETS; b++)
+			{	unsigned long long count = shard.buckets[p][b].load(std::memory_order_relaxed);
+				phase.buckets[b] += count;
+				phase.count += count;
+			}
+		}
+	}
+
+	return stats;
+}
+
+#pragma endregion
+
+
+#pragma region Serializing
+
+// Appends the string as a quoted JSON string
+static void appendString(str& json, const str& value)
+{
+	static const char digits[] = "0123456789abcdef";
+	json += '"';
+
+	for (size_t i = 0; i < value.size(); i++)
+	{	byte c = (byte)value[i];
+		if (c == '"' || c == '\\')
+		{	json += '\\';
+			json += (char)c;
+		}
+		else if (c < 0x20)
+		{	json += "\\u00";
+			json += digits[c >> 4];
+			json += digits[c & 0x0F];
+		}
+		else
+		{	json += (char)c;
+		}
+	}
+
+	json += '"';
+}
+
+// Appends a named number to a JSON object
+static void appendField(str& json, cstr name, unsigned long long value)
+{	json += '"';
+	json += name;
+	json += "\":";
+	json += std::to_string(value);
+}
+
+// Appends the latencies of a phase as a JSON object
+static void appendPhase(str& json, cstr name, const RPCHistogram& phase)
+{
+	json += '"';
+	json += name;
+	json += "\":{";
+	appendField(json, "count", phase.count);			json += ',';
+	appendField(json, "mean_ns", (unsigned long long)phase.Mean());	json += ',';
+	appendField(json, "p50_ns", phase.Percentile(50));	json += ',';
+	appendField(json, "p90_ns", phase.Percentile(90));	json += ',';
+	appendField(json, "p99_ns", phase.Percentile(99));	json += ',';
+	appendField(json, "p999_ns", phase.Percentile(99.9));	json += ',';
+	appendField(json, "max_ns", phase.Max());
+	json += '}';
+}
+
+// Serializes snapshots of the functions of a service as a JSON object
+str StatsJSON(const std::vector<RPCProcedureStats>& procedures)
+{
+	static const cstr phases[STATS_PHASES] = { "decode", "queue", "execute", "send" };
+	str json = "{\"procedures\":[";
+
+	for (size_t i = 0; i < procedures.size(); i++)
+	{	const RPCProcedureStats& stats = procedures[i];
+		json += i == 0 ? "{" : ",{";
+
+		json += "\"name\":";
+		appendString(json, stats.name);						json += ',';
+		appendField(json, "calls", stats.calls);			json += ',';
+		appendField(json, "errors", stats.errors);			json += ',';
+		appendField(json, "expired", stats.expired);		json += ',';
+		appendField(json, "overloaded", stats.overloaded);	json += ',';
+		appendField(json, "cache_hits", stats.hits);		json += ',';
+		appendField(json, "cache_misses", stats.misses);	json += ',';
+		appendField(json, "bytes_in", stats.bytesIn);		json += ',';
+		appendField(json, "bytes_out", stats.bytesOut);
+
+		for (int p = 0; p < STATS_PHASES; p++)
+		{	json += ',';
+			appendPhase(json, phases[p], stats.phases[p]);
+		}
+		json += '}';
+	}
+
+	json += "]}";
+	return json;
+}
+
+#pragma endregion
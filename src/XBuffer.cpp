@@ -0,0 +1,108 @@
+#include <rpc-service/XBuffer.h>
+
+#include <algorithm>
+
+// Returns the class of the smallest buffers holding the size
+static int classOf(size_t size)
+{
+	int index = 0;
+	while (((size_t)1 << (index + XBUFFER_MIN)) < size)
+	{	index++;
+	}
+	return index;
+}
+
+
+// Creates an empty pool
+// Classes of large buffers keep fewer of them, within XBUFFER_RETAIN bytes
+XBufferPool::XBufferPool() : hits(0), misses(0)
+{
+	for (int i = 0; i < XBUFFER_CLASSES; i++)
+	{	size_t size = (size_t)1 << (i + XBUFFER_MIN);
+		classes[i].keep = std::max<size_t>(1, std::min<size_t>(XBUFFER_KEEP, XBUFFER_RETAIN / size));
+		classes[i].free.reserve(classes[i].keep);
+	}
+}
+
+
+// Returns an empty string able to hold at least size bytes
+// Takes a free buffer of the right class if there is one, otherwise allocates
+// the full size of the class. Sizes above the largest class always allocate.
+str XBufferPool::Acquire(const size_t size)
+{
+	str buffer;
+	int index = classOf(size);
+
+	if (index < XBUFFER_CLASSES)
+	{	XBufferClass& sized = classes[index];
+		std::lock_guard<std::mutex> guard(sized.lock);
+
+		if (!sized.free.empty())
+		{	buffer.swap(sized.free.back());
+			sized.free.pop_back();
+			hits++;
+			return buffer;
+		}
+	}
+
+	misses++;
+	buffer.reserve(index < XBUFFER_CLASSES ? (size_t)1 << (index + XBUFFER_MIN) : size);
+	return buffer;
+}
+
+
+// Takes the memory of the string back into the pool, leaving it empty
+// Buffers too small or too large to pool, or released while their class is
+// full, are freed instead
+void XBufferPool::Release(str& buffer)
+{
+	size_t capacity = buffer.capacity();
+	str taken;
+	taken.swap(buffer);
+
+	if (capacity < ((size_t)1 << XBUFFER_MIN))
+	{	return;
+	}
+
+	// A buffer belongs to the largest class it can hold entirely
+	int index = classOf(capacity + 1) - 1;
+	if (index >= XBUFFER_CLASSES)
+	{	return;
+	}
+
+	XBufferClass& sized = classes[index];
+	std::lock_guard<std::mutex> guard(sized.lock);
+
+	if (sized.free.size() < sized.keep)
+	{	taken.clear();
+		sized.free.push_back(std::move(taken));
+	}
+}
+
+
+// Moves the contents of the string into a pooled buffer able to hold size
+// bytes, and releases its old buffer. Does nothing if the string is big enough.
+// Past the largest class the buffer at least doubles, so a string growing in
+// steps is only copied a few times.
+void XBufferPool::Grow(str& buffer, const size_t size)
+{
+	if (buffer.capacity() >= size)
+	{	return;
+	}
+
+	size_t largest = (size_t)1 << XBUFFER_MAX;
+	str grown = Acquire(size > largest ? std::max(size, buffer.capacity() * 2) : size);
+	grown.append(buffer);
+	Release(buffer);
+	buffer.swap(grown);
+}
+
+
+// Returns the pool shared by the sockets, frames and marshalling
+// Created on first use and never destroyed, so buffers can still be released
+// while other static objects are destroyed
+XBufferPool& Buffers()
+{
+	static XBufferPool* pool = new XBufferPool();
+	return *pool;
+}
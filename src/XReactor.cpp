@@ -0,0 +1,549 @@
+#include <rpc-service/XReactor.h>
+
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+// Largest number of bytes read from a peer in one go
+#define REACTOR_READ 65536
+
+
+#pragma region Peer
+
+// Creates a peer taking the ownership of the socket watched by the reactor
+XPeer::XPeer(XSocket* _socket, XReactor* _reactor, size_t _backlog)
+: socket(_socket), reactor(_reactor), flushed(0), backlog(_backlog), waiting(false), inflight(0) {}
+
+// Deletes the socket of the peer
+XPeer::~XPeer()
+{	IXSocket(socket).Delete();
+}
+
+// Sends the data through the socket without interleaving it with other threads
+// Returns true if the data was sent or queued
+bool XPeer::Send(const str& data)
+{	XSlice slice = XSlice{ data.data(), data.size() };
+	return Send(&slice, 1);
+}
+
+// Sends the slices as one write without interleaving them with other threads
+// Writes what the socket takes right away, unless bytes are queued already,
+// and queues the rest for the reactor. The peer is closed if the queue would
+// grow past the backlog.
+// Returns true if the data was sent or queued. Otherwise unsent, if given,
+// tells if the send failed before any byte of the data left.
+bool XPeer::Send(const XSlice* slices, const int count, bool* unsent)
+{
+	std::lock_guard<std::mutex> guard(sendLock);
+	IXSocket conn(socket);
+
+	size_t total   = 0;
+	size_t written = 0;
+
+	for (int i = 0; i < count; i++)
+	{	total += slices[i].size;
+	}
+
+	if (unsent != NULL)
+	{	*unsent = true;
+	}
+
+	if (!conn.good())
+	{	return false;
+	}
+
+	if (!waiting)
+	{	long sent = conn.Write(slices, count, 0, REACTOR_REAP);
+		if (sent < 0)
+		{	Fail();
+			return false;
+		}
+		written = (size_t)sent;
+	}
+
+	if (unsent != NULL)
+	{	*unsent = written == 0 && !waiting;
+	}
+
+	if (!conn.good())
+	{	Fail();
+		return false;
+	}
+
+	if (written == total)
+	{	return true;
+	}
+
+	if (output.size() - flushed + total - written > backlog)
+	{	Fail();
+		return false;
+	}
+
+	size_t skip = written;
+	for (int i = 0; i < count; i++)
+	{	if (skip < slices[i].size)
+		{	output.append(slices[i].data + skip, slices[i].size - skip);
+		}
+		skip -= std::min(skip, slices[i].size);
+	}
+
+	if (!waiting)
+	{	waiting = true;
+		reactor->Watch(this, true);
+	}
+
+	return true;
+}
+
+// Writes the queued bytes the socket takes, from the reactor's thread
+// Stops watching for room once the queue is empty, and wakes the threads
+// waiting for it
+// Returns false if the peer failed
+bool XPeer::Flush()
+{
+	{	std::lock_guard<std::mutex> guard(sendLock);
+		IXSocket conn(socket);
+
+		if (flushed < output.size())
+		{	XSlice slice = XSlice{ output.data() + flushed, output.size() - flushed };
+			long sent = conn.Write(&slice, 1, 0, REACTOR_REAP);
+			if (sent < 0)
+			{	Fail();
+				return false;
+			}
+			flushed += (size_t)sent;
+		}
+
+		if (flushed < output.size())
+		{	return true;
+		}
+
+		// The memory of a large queue isn't kept for the next one
+		if (output.capacity() > REACTOR_READ)
+		{	str().swap(output);
+		}
+		output.clear();
+		flushed = 0;
+		waiting = false;
+		reactor->Watch(this, false);
+	}
+
+	reactor->Flushed();
+	return true;
+}
+
+// Returns true if the other end closed the connection, or it failed
+// Checked before reusing an idle connection, as the reactor may not have
+// read the end of its stream yet.
+bool XPeer::Stale()
+{
+	if (!good())
+	{	return true;
+	}
+
+	char byte = 0;
+#ifdef _WIN32
+	int peeked = recv(socket->socketObj, &byte, 1, MSG_PEEK);
+	return peeked == 0 || (peeked < 0 && WSAGetLastError() != WSAEWOULDBLOCK);
+#else
+	int peeked = (int)recv(socket->socketObj, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+	return peeked == 0 || (peeked < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+#endif
+}
+
+// Returns true if the socket of the peer is working as intended
+bool XPeer::good()
+{	return IXSocket(socket).good();
+}
+
+// Drops the queued bytes and shuts the connection down
+// The reactor then reads the end of the stream and removes the peer
+void XPeer::Fail()
+{
+	IXSocket conn(socket);
+	conn.Shutdown(true);
+	socket->flag |= 0x06;
+
+	output.clear();
+	flushed = 0;
+}
+
+#pragma endregion
+
+
+#pragma region Constructors
+
+// Creates a stopped reactor with no peers
+XReactor::XReactor() : running(false), backlog(REACTOR_BACKLOG)
+{
+#ifndef _WIN32
+	pollObj = -1;
+	wakeObj = -1;
+#endif
+}
+
+// Stops the event loop and releases the peers
+XReactor::~XReactor()
+{
+	Stop();
+	Close();
+}
+
+#pragma endregion
+
+
+#pragma region Methods
+
+// Starts the event loop on a new thread with the callbacks specified
+// Returns false if the loop could not be started
+bool XReactor::Start(XReactorFn fn, XReactorCloseFn closeFn, XReactorTimerFn timerFn)
+{
+	Stop();
+	callback = fn;
+	closed   = closeFn;
+	timer    = timerFn;
+
+#ifndef _WIN32
+	if (pollObj == -1)
+	{	pollObj = epoll_create1(EPOLL_CLOEXEC);
+	}
+	if (wakeObj == -1)
+	{	wakeObj = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+		epoll_event ev = epoll_event{};
+		ev.events   = EPOLLIN;
+		ev.data.ptr = NULL;
+		epoll_ctl(pollObj, EPOLL_CTL_ADD, wakeObj, &ev);
+	}
+	if (pollObj == -1 || wakeObj == -1)
+	{	return false;
+	}
+#endif
+
+	running = true;
+	loopThr = std::thread(&XReactor::Loop, this);
+	return true;
+}
+
+
+// Hands the ownership of a connected socket to the reactor
+// Frames with a payload larger than frameMax bytes close the peer
+// Returns the peer made of the socket, or NULL if it could not be watched
+std::shared_ptr<XPeer> XReactor::Add(IXSocket conn, const size_t frameMax)
+{
+	if (conn.xsocket == NULL)
+	{	return NULL;
+	}
+
+	std::shared_ptr<XPeer> peer = std::make_shared<XPeer>(conn.xsocket, this, backlog);
+	peer->decoder.max = frameMax;
+
+	{	std::lock_guard<std::mutex> guard(lock);
+		peers[peer.get()] = peer;
+	}
+
+#ifdef _WIN32
+	// Writes return once the socket is full, the reactor writes the rest
+	u_long nonblocking = 1;
+	ioctlsocket(conn.xsocket->socketObj, FIONBIO, &nonblocking);
+#else
+	epoll_event ev = epoll_event{};
+	ev.events   = EPOLLIN | EPOLLRDHUP;
+	ev.data.ptr = peer.get();
+
+	if (0 != epoll_ctl(pollObj, EPOLL_CTL_ADD, conn.xsocket->socketObj, &ev))
+	{	Remove(peer.get());
+		return NULL;
+	}
+#endif
+
+	return peer;
+}
+
+
+// Stops watching the peer and drops the reactor's reference to it
+// The socket is deleted once no other thread holds the peer
+void XReactor::Remove(XPeer* peer)
+{
+	std::shared_ptr<XPeer> owned;
+	{	std::lock_guard<std::mutex> guard(lock);
+		auto it = peers.find(peer);
+		if (it == peers.end())
+		{	return;
+		}
+
+		owned = it->second;
+		peers.erase(it);
+	}
+
+#ifndef _WIN32
+	if (owned->socket->socketObj != INVALID_SOCKET)
+	{	epoll_ctl(pollObj, EPOLL_CTL_DEL, owned->socket->socketObj, NULL);
+	}
+#endif
+
+	// Bytes queued for the peer won't be written anymore
+	if (owned->waiting)
+	{	Flushed();
+	}
+}
+
+
+// Watches the socket of the peer for room to write its queued bytes, or stops
+// watching it, called with the peer's send lock held
+// The loop of Windows checks the peers' queues on every wait instead
+void XReactor::Watch(XPeer* peer, bool writable)
+{
+#ifndef _WIN32
+	epoll_event ev = epoll_event{};
+	ev.events   = EPOLLIN | EPOLLRDHUP | (writable ? (uint)EPOLLOUT : 0);
+	ev.data.ptr = peer;
+
+	if (peer->socket->socketObj != INVALID_SOCKET)
+	{	epoll_ctl(pollObj, EPOLL_CTL_MOD, peer->socket->socketObj, &ev);
+	}
+#else
+	(void)peer;
+	(void)writable;
+#endif
+}
+
+// Wakes the threads waiting for the queues of the peers to be written
+void XReactor::Flushed()
+{
+	{	std::lock_guard<std::mutex> guard(flushLock);
+	}
+	flushSignal.notify_all();
+}
+
+// Returns true if no peer has bytes waiting to be written
+bool XReactor::Idle()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	for (auto it = peers.begin(); it != peers.end(); it++)
+	{	if (it->second->waiting && it->second->good())
+		{	return false;
+		}
+	}
+	return true;
+}
+
+// Waits until the bytes queued for every peer were written, or the deadline passed
+// Returns false if bytes were still waiting at the deadline
+bool XReactor::Flush(std::chrono::steady_clock::time_point deadline)
+{
+	std::unique_lock<std::mutex> guard(flushLock);
+	return flushSignal.wait_until(guard, deadline, [this]() { return Idle(); });
+}
+
+
+// Returns the peer if it's still owned by the reactor, NULL otherwise
+std::shared_ptr<XPeer> XReactor::Find(XPeer* peer)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	auto it = peers.find(peer);
+	return it != peers.end() ? it->second : NULL;
+}
+
+
+// Reads the bytes available on a socket that became readable
+// Passes the complete frames to the callback, and keeps partial frames for
+// the next read. Removes the peer if it disconnected or sent an invalid frame.
+void XReactor::Read(std::shared_ptr<XPeer> peer)
+{
+	static thread_local char buffer[REACTOR_READ];
+
+	int received = 0;
+	do
+	{	received = (int)recv(peer->socket->socketObj, buffer, REACTOR_READ, 0);
+#ifdef _WIN32
+	} while (false);
+
+	if (received < 0 && WSAGetLastError() == WSAEWOULDBLOCK)
+	{	return;
+	}
+#else
+	} while (received < 0 && errno == EINTR);
+
+	if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+	{	return;
+	}
+#endif
+
+	if (received > 0)
+	{	peer->decoder.Feed(buffer, received);
+	}
+
+	// Kept between reads so the loop doesn't allocate a list for every read
+	static thread_local std::vector<Frame> frames;
+	Frame frame;
+	frames.clear();
+
+	while (peer->decoder.Next(frame))
+	{	frames.push_back(std::move(frame));
+	}
+
+	if (!frames.empty())
+	{	callback(peer, frames);
+	}
+
+	if (received <= 0 || peer->decoder.failed)
+	{	peer->socket->flag |= 0x06;
+		Remove(peer.get());
+
+		if (closed)
+		{	closed(peer);
+		}
+	}
+}
+
+
+// Waits for readable sockets and reads them until the reactor is stopped
+void XReactor::Loop()
+{
+#ifdef _WIN32
+	std::vector<WSAPOLLFD> fds;
+	std::vector<std::shared_ptr<XPeer> > owners;
+
+	while (running)
+	{
+		fds.clear();
+		owners.clear();
+
+		{	std::lock_guard<std::mutex> guard(lock);
+			for (auto it = peers.begin(); it != peers.end(); it++)
+			{	WSAPOLLFD fd = WSAPOLLFD{};
+				fd.fd = it->second->socket->socketObj;
+				fd.events = POLLRDNORM | (it->second->waiting ? POLLWRNORM : 0);
+				fds.push_back(fd);
+				owners.push_back(it->second);
+			}
+		}
+
+		if (fds.empty())
+		{	if (timer)
+			{	timer();
+			}
+			Sleep(1);
+			continue;
+		}
+
+		// Short timeout so new peers and stop requests are noticed
+		int wait  = timer ? timer() : -1;
+		int ready = WSAPoll(fds.data(), (ULONG)fds.size(), wait >= 0 && wait < 10 ? wait : 10);
+
+		for (size_t i = 0; ready > 0 && i < fds.size(); i++)
+		{	if ((fds[i].revents & POLLWRNORM) != 0)
+			{	owners[i]->Flush();
+			}
+
+			// Failed peers are read so they're removed
+			bool failed = !owners[i]->good();
+			if (((fds[i].revents & ~POLLWRNORM) != 0 || failed) && Find(owners[i].get()) != NULL)
+			{	Read(owners[i]);
+			}
+		}
+	}
+#else
+	epoll_event events[64];
+
+	while (running)
+	{
+		int wait  = timer ? timer() : -1;
+		int ready = epoll_wait(pollObj, events, 64, wait);
+
+		for (int i = 0; i < ready; i++)
+		{	if (events[i].data.ptr == NULL)
+			{	uint64_t count = 0;
+				ssize_t r = read(wakeObj, &count, sizeof(count));
+				(void)r;
+				continue;
+			}
+
+			// The peer may have been removed since the event was queued
+			std::shared_ptr<XPeer> peer = Find((XPeer*)events[i].data.ptr);
+			if (peer != NULL && (events[i].events & EPOLLOUT) != 0)
+			{	peer->Flush();
+			}
+			if (peer != NULL && (events[i].events & ~EPOLLOUT) != 0)
+			{	Read(peer);
+			}
+		}
+	}
+#endif
+}
+
+#pragma endregion
+
+
+#pragma region Cleaning
+
+// Interrupts the wait of the event loop, so the timer runs again
+// The loop of Windows waits at most 10 milliseconds and needs no waking
+void XReactor::Wake()
+{
+#ifndef _WIN32
+	if (wakeObj != -1)
+	{	uint64_t count = 1;
+		ssize_t w = write(wakeObj, &count, sizeof(count));
+		(void)w;
+	}
+#endif
+}
+
+// Stops the event loop and waits for its thread to finish
+// Peers stay connected until the reactor is closed
+void XReactor::Stop()
+{
+	running = false;
+	Wake();
+
+	if (loopThr.joinable())
+	{	loopThr.join();
+	}
+}
+
+// Drops the reactor's reference to every peer
+// The close callback is notified of every peer it held
+void XReactor::Close()
+{
+	std::unordered_map<XPeer*, std::shared_ptr<XPeer> > owned;
+	{	std::lock_guard<std::mutex> guard(lock);
+		owned.swap(peers);
+	}
+
+#ifndef _WIN32
+	for (auto it = owned.begin(); it != owned.end(); it++)
+	{	if (it->second->socket->socketObj != INVALID_SOCKET)
+		{	epoll_ctl(pollObj, EPOLL_CTL_DEL, it->second->socket->socketObj, NULL);
+		}
+	}
+#endif
+
+	for (auto it = owned.begin(); it != owned.end(); it++)
+	{	if (closed)
+		{	closed(it->second);
+		}
+	}
+
+	owned.clear();
+
+#ifndef _WIN32
+	if (wakeObj != -1)
+	{	close(wakeObj);
+	}
+	if (pollObj != -1)
+	{	close(pollObj);
+	}
+
+	pollObj = -1;
+	wakeObj = -1;
+#endif
+}
+
+#pragma endregion
@@ -1,37 +1,206 @@
 #include <rpc-service/XSocket.h>
-#include <time.h>
+#include <rpc-service/XBuffer.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
 
+#ifndef _WIN32
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
 
-// Attempts to connect the socket to the specified address
-// Failing to connect sets error flags and quits the thread
-// Connection is re-tried if times out or refused untill time threshold reached
-static DWORD WINAPI connectFn(LPVOID lpParameter)
+
+#pragma region Connecting
+
+#ifdef _WIN32
+// Creates a non-blocking TCP socket of the family
+static SOCKET connectSocket(const int family)
+{
+	SOCKET s = socket(family, SOCK_STREAM, IPPROTO_TCP);
+	u_long nonBlocking = 1;
+
+	if (s != INVALID_SOCKET && 0 != ioctlsocket(s, FIONBIO, &nonBlocking))
+	{	closesocket(s);
+		return INVALID_SOCKET;
+	}
+	return s;
+}
+
+static void closeSocket(SOCKET s)	{ closesocket(s); }
+static int  lastError()				{ return WSAGetLastError(); }
+static bool pending(int error)		{ return error == WSAEWOULDBLOCK || error == WSAEINPROGRESS; }
+static bool retried(int error)		{ return error == WSAECONNREFUSED || error == WSAETIMEDOUT; }
+static int  pollSockets(pollfd* fds, size_t count, int timeout) { return WSAPoll(fds, (ULONG)count, timeout); }
+#else
+// Creates a non-blocking TCP socket of the family
+static SOCKET connectSocket(const int family)
+{	return socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+}
+
+static void closeSocket(SOCKET s)	{ close(s); }
+static int  lastError()				{ return errno; }
+static bool pending(int error)		{ return error == EINPROGRESS; }
+static bool retried(int error)		{ return error == ECONNREFUSED || error == ETIMEDOUT; }
+static int  pollSockets(pollfd* fds, size_t count, int timeout) { return poll(fds, (nfds_t)count, timeout); }
+#endif
+
+
+// Resolves the name or numeric address of a host into every address it has
+// Addresses alternate between families, starting with the first one found
+std::vector<XAddress> XResolve(const str& host, const int port, const int type)
+{
+	std::vector<XAddress> first, second, addresses;
+	addrinfo  hints = addrinfo{};
+	addrinfo* found = NULL;
+	str service = std::to_string(port);
+
+	hints.ai_family   = AF_UNSPEC;
+	hints.ai_socktype = type == TCP ? SOCK_STREAM : SOCK_DGRAM;
+
+	if (0 != getaddrinfo(host.c_str(), service.c_str(), &hints, &found))
+	{	return addresses;
+	}
+
+	for (addrinfo* info = found; info != NULL; info = info->ai_next)
+	{	if (info->ai_addrlen > sizeof(sockaddr_storage))
+		{	continue;
+		}
+
+		XAddress address = XAddress{};
+		memcpy(&address.address, info->ai_addr, info->ai_addrlen);
+		address.size = (socklen_t)info->ai_addrlen;
+		(info->ai_family == found->ai_family ? first : second).push_back(address);
+	}
+
+	freeaddrinfo(found);
+
+	for (size_t i = 0; i < first.size() || i < second.size(); i++)
+	{	if (i < first.size())	{ addresses.push_back(first[i]); }
+		if (i < second.size())	{ addresses.push_back(second[i]); }
+	}
+	return addresses;
+}
+
+
+// Connects a new TCP socket to one of the addresses, racing them in turn
+// A new attempt starts when there is none in flight, or when the last one
+// has had its head start. Attempts failing right away move on to the next
+// address. Once every address has failed, the round starts over after the
+// backoff if any of them refused or timed out.
+SOCKET XConnect(const std::vector<XAddress>& addresses, const int timeout, size_t* used)
 {
-	XSocket* const XS = (XSocket*)lpParameter;
-	long long startTime = time(NULL);
+	typedef std::chrono::steady_clock clock;
 
-	while ((XS->flag & 0x0F) == 12 && time(NULL) - startTime < XS->ctime)
+	auto deadline = clock::now() + std::chrono::milliseconds(timeout);
+	auto started  = clock::now();
+	int  backoff  = XSOCKET_BACKOFF_MIN;
+	bool retry    = false;
+	size_t next   = 0;
+
+	SOCKET connected = INVALID_SOCKET;
+	std::vector<pollfd> attempts;		// Sockets of the attempts in flight
+	std::vector<size_t> indices;		// Index of the address of each attempt
+
+	while (connected == INVALID_SOCKET)
 	{
-		if (0 == connect(XS->socketObj, (struct sockaddr *) &XS->addrInfo, sizeof(XS->addrInfo)))
-		{	XS->flag &= 0xFB;
-			break;
+		auto now = clock::now();
+		if (now >= deadline)
+		{	break;
+		}
+
+		// Starts the attempt to the next address
+		if (next < addresses.size() && (attempts.empty() || now >= started + std::chrono::milliseconds(XSOCKET_STAGGER)))
+		{	const XAddress& address = addresses[next];
+			SOCKET s = connectSocket(address.address.ss_family);
+
+			if (s != INVALID_SOCKET && 0 == connect(s, (const sockaddr*)&address.address, address.size))
+			{	connected = s;
+				*used = next;
+			}
+			else if (s != INVALID_SOCKET && pending(lastError()))
+			{	pollfd fd = pollfd{};
+				fd.fd     = s;
+				fd.events = POLLOUT;
+				attempts.push_back(fd);
+				indices.push_back(next);
+				started = now;
+			}
+			else if (s != INVALID_SOCKET)
+			{	retry = retry || retried(lastError());
+				closeSocket(s);
+			}
+
+			next++;
+			continue;
 		}
 
-		int error = WSAGetLastError();
-		if (error != WSAETIMEDOUT && error != WSAECONNREFUSED)
-		{	XS->flag |= 0x02;
+		// Every address failed, tries them all again after the backoff
+		// The last round is left some time to connect before the deadline
+		if (attempts.empty())
+		{	int left = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() - XSOCKET_BACKOFF_MIN;
+			if (!retry || left <= 0)
+			{	break;
+			}
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(std::min(backoff, left)));
+			backoff = std::min(backoff * 2, XSOCKET_BACKOFF_MAX);
+			retry = false;
+			next  = 0;
+			continue;
 		}
+
+		// Waits for an attempt to complete, or for the next one to start
+		auto until = deadline;
+		if (next < addresses.size())
+		{	until = std::min(until, started + std::chrono::milliseconds(XSOCKET_STAGGER));
+		}
+
+		int wait  = (int)std::chrono::duration_cast<std::chrono::milliseconds>(until - now).count();
+		int ready = pollSockets(attempts.data(), attempts.size(), wait < 0 ? 0 : wait + 1);
+		if (ready <= 0)
+		{	continue;
+		}
+
+		for (size_t i = attempts.size(); i-- > 0;)
+		{	if (attempts[i].revents == 0 || connected != INVALID_SOCKET)
+			{	continue;
+			}
+
+			int error = 0;
+			socklen_t errlen = sizeof(error);
+			getsockopt(attempts[i].fd, SOL_SOCKET, SO_ERROR, (char*)&error, &errlen);
+
+			if (error == 0)
+			{	connected = attempts[i].fd;
+				*used = indices[i];
+			}
+			else
+			{	retry = retry || retried(error);
+				closeSocket(attempts[i].fd);
+			}
+
+			attempts.erase(attempts.begin() + i);
+			indices.erase(indices.begin() + i);
+		}
+	}
+
+	for (size_t i = 0; i < attempts.size(); i++)
+	{	closeSocket(attempts[i].fd);
 	}
 
-	XS->connectThr = NULL;
-	return 0;
+	return connected;
 }
 
+#pragma endregion
+
+
+#ifdef _WIN32
 
 // Craetes an empty socket with placeholder values
 XSocket::XSocket()
 {
-	this->connectThr = NULL;
 	this->socketObj  = INVALID_SOCKET;
 	
 	this->flag  = 0xFF;
@@ -40,6 +209,9 @@ XSocket::XSocket()
 	this->port  = 0;
 	this->type  = 0;
 	this->ctime = 0;
+	this->rtime = 0;
+	this->backlog  = 0;
+	this->zeroCopy = 0;
 }
 
 
@@ -48,7 +220,6 @@ XSocket::XSocket()
 // Starts receiving from the socket in a different thread
 XSocket::XSocket(const SOCKET socket, const sockaddr_in addrinf)
 {
-	this->connectThr = NULL;
 	this->socketObj  = socket;
 	this->addrInfo   = addrinf;
 	
@@ -57,6 +228,9 @@ XSocket::XSocket(const SOCKET socket, const sockaddr_in addrinf)
 	this->host = false;
 	this->type  = TCP;
 	this->ctime = 0;
+	this->rtime = 0;
+	this->backlog  = 0;
+	this->zeroCopy = 0;
 
 	auto ip = addrInfo.sin_addr.S_un.S_un_b;
 
@@ -74,6 +248,7 @@ XSocket::XSocket(const SOCKET socket, const sockaddr_in addrinf)
 	delete[] cstring;
 }
 
+#endif
 
 // Creates a new interface managing a new socket
 IXSocket::IXSocket() : xsocket(new XSocket()) { }
@@ -84,15 +259,22 @@ IXSocket::IXSocket(XSocket* socket) : xsocket(socket) {  }
 // Creates a copy of the interface specified
 IXSocket::IXSocket(const IXSocket& obj) : xsocket(obj.xsocket) { }
 
+// Makes the interface manage the socket of the one specified
+IXSocket& IXSocket::operator=(const IXSocket& obj)
+{	xsocket = obj.xsocket;
+	return *this;
+}
+
 #pragma endregion
 
 
 #pragma region Methods
 
+#ifdef _WIN32
 //Constructs the socket with the given parameters and opens the connection.
 //If the process encounters an error, error flags are set, and the process halts.
 //Successful connection leaves all 3 flags at 0, meaning flag|0x07 is 0.
-void XSocket::Open(const int _type, const str _addr, const int _port, const int _ctime = 1)
+void XSocket::Open(const int _type, const str _addr, const int _port, const int _ctime = XSOCKET_CTIME)
 {
 	Close();
 
@@ -107,21 +289,35 @@ void XSocket::Open(const int _type, const str _addr, const int _port, const int
 	{	flag &= 0xFE;
 	}
 
-	auto inf_socket   = type == TCP ? SOCK_STREAM : SOCK_DGRAM;
-	auto inf_protocol = type == TCP ? IPPROTO_TCP : IPPROTO_UDP;
+	std::vector<XAddress> addresses;
+	if ((flag & 0x01) == 0)
+	{	addresses = XResolve(addr, port, type);
+	}
+
+	// Datagrams are sent to the first IPv4 address
 	ZeroMemory(&addrInfo, sizeof(addrInfo));
+	for (size_t i = 0; i < addresses.size(); i++)
+	{	if (addresses[i].address.ss_family == AF_INET)
+		{	memcpy(&addrInfo, &addresses[i].address, sizeof(addrInfo));
+			break;
+		}
+	}
 
-	if ((flag & 0x03) == 2 && INVALID_SOCKET != (socketObj = socket(AF_INET, inf_socket, inf_protocol)))
-	{
-		flag &= 0xFD;
-		addrInfo.sin_family = AF_INET;
-		addrInfo.sin_port = htons(port);
-		addrInfo.sin_addr.S_un.S_addr = inet_addr(addr.data());
+	if ((flag & 0x03) == 2 && type == UDP && addrInfo.sin_family == AF_INET)
+	{	if (INVALID_SOCKET != (socketObj = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)))
+			flag &= 0xFD;
 	}
 
-	if ((flag & 0x0F) == 12 && type == TCP)
-	{	connectThr = CreateThread(0, 0, connectFn, (LPDWORD)this, 0, NULL);
-		for (long long startTime = time(NULL); (flag & 0x0F) == 12 && time(NULL) - startTime < ctime;) {}
+	// The socket connects without blocking, and blocks again once connected
+	size_t used = 0;
+	if ((flag & 0x03) == 2 && type == TCP && INVALID_SOCKET != (socketObj = XConnect(addresses, ctime, &used)))
+	{	u_long nonBlocking = 0;
+		ioctlsocket(socketObj, FIONBIO, &nonBlocking);
+		flag &= 0xF9;
+
+		if (addresses[used].address.ss_family == AF_INET)
+		{	memcpy(&addrInfo, &addresses[used].address, sizeof(addrInfo));
+		}
 	}
 }
 
@@ -130,7 +326,7 @@ void XSocket::Open(const int _type, const str _addr, const int _port, const int
 //Constructs the socket with the given parameters and opens the connection.
 //If the process encounters an error, error flags are set, and the process halts.
 //Successful connection leaves all 3 flags at 0, meaning flag|0x07 is 0.
-void XSocket::Host(int _type, int _port)
+void XSocket::Host(int _type, int _port, int _backlog)
 {
 	Close();
 
@@ -138,6 +334,7 @@ void XSocket::Host(int _type, int _port)
 	this->port = _port;
 	this->type = _type;
 	this->ctime = 0;
+	this->backlog = _backlog;
 	this->host = true;
 	this->flag |= 0x0E;
 
@@ -159,7 +356,7 @@ void XSocket::Host(int _type, int _port)
 
 	if ((flag & 0x0F) == 12 && type == TCP)
 	{	if (0 == bind(socketObj, (struct sockaddr *) &addrInfo, addrlen))
-			if (0 == listen(socketObj, 10))
+			if (0 == listen(socketObj, backlog))
 				flag &= 0xF7;
 	}		
 	else if ((flag & 0x0F) == 12 && type == UDP)
@@ -171,7 +368,7 @@ void XSocket::Host(int _type, int _port)
 
 //If the connection is successfully established, sends a C-String with a size to the receiver.
 //If an error occurs, it raises the connection and the socket error flags.
-void XSocket::Send(const str data, const int size)
+void XSocket::Send(const str& data, const int size)
 {
 	int addrlen = sizeof(addrInfo);
 	int sent = 0;
@@ -183,17 +380,141 @@ void XSocket::Send(const str data, const int size)
 			flag &= 0xFB;
 	}
 
+	// Keeps sending until the whole buffer is written
+	int total = 0;
 	if (type == TCP && (flag & 0x07) == 0 && data != "")
-		sent = send(socketObj, data.data(), size, 0);
+	{	while (total < size)
+		{	sent = send(socketObj, data.data() + total, size - total, 0);
+			if (sent < 1)
+				break;
+			total += sent;
+		}
+
+		sent = total < size ? 0 : total;
+	}
 
 	if (sent < 1)
 		flag |= 0x06;
 }
 
 
+//Sends the slices one after the other as a single stream with as few calls as possible
+//Partial sends are continued from the first byte that was not sent
+//If an error occurs, it raises the connection and the socket error flags.
+void XSocket::Send(const XSlice* slices, const int count)
+{
+	int  first = 0;
+	size_t skip = 0;
+
+	while (type == TCP && (flag & 0x07) == 0)
+	{
+		while (first < count && slices[first].size == skip)
+		{	first++;
+			skip = 0;
+		}
+
+		if (first == count)
+			return;
+
+		WSABUF buffers[XSOCKET_SLICES];
+		DWORD  used = 0;
+
+		for (int i = first; i < count && used < XSOCKET_SLICES; i++, used++)
+		{	size_t offset = i == first ? skip : 0;
+			buffers[used].buf = (CHAR*)slices[i].data + offset;
+			buffers[used].len = (ULONG)(slices[i].size - offset);
+		}
+
+		DWORD sent = 0;
+		if (0 != WSASend(socketObj, buffers, used, &sent, 0, NULL, NULL) || sent == 0)
+			break;
+
+		// Moves past the slices that were sent entirely
+		while (sent > 0)
+		{	size_t rest = slices[first].size - skip;
+			if (sent >= rest)
+			{	sent -= (DWORD)rest;
+				first++;
+				skip = 0;
+			}
+			else
+			{	skip += sent;
+				sent  = 0;
+			}
+		}
+	}
+
+	flag |= 0x06;
+}
+
+
+//Writes the slices from the offset as far as the socket takes them, without
+//waiting for room if the socket is non-blocking. Every write copies.
+//Returns the number of bytes written, or -1 if an error occurs before any
+//byte was written. Errors raise the connection and the socket error flags.
+long XSocket::Write(const XSlice* slices, const int count, const size_t offset, const int)
+{
+	int    first   = 0;
+	size_t skip    = offset;
+	long   written = 0;
+
+	while (type == TCP && (flag & 0x07) == 0)
+	{
+		while (first < count && slices[first].size <= skip)
+		{	skip -= slices[first].size;
+			first++;
+		}
+
+		if (first == count)
+			return written;
+
+		WSABUF buffers[XSOCKET_SLICES];
+		DWORD  used = 0;
+
+		for (int i = first; i < count && used < XSOCKET_SLICES; i++, used++)
+		{	size_t from = i == first ? skip : 0;
+			buffers[used].buf = (CHAR*)slices[i].data + from;
+			buffers[used].len = (ULONG)(slices[i].size - from);
+		}
+
+		DWORD sent = 0;
+		if (0 != WSASend(socketObj, buffers, used, &sent, 0, NULL, NULL))
+		{	if (WSAGetLastError() == WSAEWOULDBLOCK)
+				return written;
+			break;
+		}
+		if (sent == 0)
+			break;
+
+		written += (long)sent;
+		skip    += sent;
+	}
+
+	flag |= 0x06;
+	return written == 0 ? -1 : written;
+}
+
+
+//Zero-copy sends are not available with winsock, every send copies
+void XSocket::ZeroCopy(const int threshold)
+{
+	zeroCopy = 0;
+}
+
+
+//Reads fail once no data arrived for timeout milliseconds, leaving the
+//connection in error. Reads wait forever if the timeout is not positive.
+void XSocket::Timeout(const int timeout)
+{
+	DWORD wait = timeout > 0 ? (DWORD)timeout : 0;
+	rtime = (int)wait;
+	setsockopt(socketObj, SOL_SOCKET, SO_RCVTIMEO, (const char*)&wait, sizeof(wait));
+}
+
+
 //If the connection is successfully established, sends a C-String with a size to the receiver.
 //If an error occurs, it raises the connection and the socket error flags.
-void XSocket::Send(const str data, const int size, const sockaddr_in address)
+void XSocket::Send(const str& data, const int size, const sockaddr_in address)
 {
 	int addrlen = sizeof(address);
 	int sent = 0;
@@ -213,37 +534,62 @@ void XSocket::Send(const str data, const int size, const sockaddr_in address)
 // Blocks the thread untill there is a message in the queue and returns it
 // Sets the address when using datagrams
 // Returns empty string on failure
+// The message is received straight into a pooled buffer
 str XSocket::Recv(sockaddr_in* address, const int maxSize = 256)
 {
 	sockaddr_in addr = sockaddr_in{};
 	int addrlen = sizeof(addr);
-	str result  = "";
+	str result  = Buffers().Acquire(maxSize);
+	result.resize(maxSize);
 
 	int received = 0;
-	char* buffer = new char[maxSize];
+	char* buffer = &result[0];
 
 	if (type == UDP || (type == UDP && host))
 	{
 		received = recvfrom(socketObj, buffer, maxSize, NULL, (struct sockaddr*) (address != NULL ? address : NULL), (address != NULL ? &addrlen : NULL));
-		if (received > 0)
-			result = std::string(buffer, received);
 	}
 	else if (type == TCP)
 	{
 		received = recv(socketObj, buffer, maxSize, 0);
-		if (received > 0)
-			result = std::string(buffer, received);
 	}
 
-	if (received <= 0)
-	{	flag |= 0x06;
+	if (received > 0)
+	{	result.resize(received);
+	}
+	else
+	{	result.clear();
+		flag |= 0x06;
 	}
 
-	delete[] buffer;
 	return result;
 }
 
 
+// Blocks the thread untill exactly size bytes are received into the buffer
+// Only applicable to TCP sockets
+// Returns false and sets the error flags on failure
+bool XSocket::Read(char* buffer, const int size)
+{
+	int total = 0;
+
+	while (type == TCP && (flag & 0x07) == 0 && total < size)
+	{	int received = recv(socketObj, buffer + total, size - total, 0);
+
+		if (received <= 0)
+		{	break;
+		}
+		total += received;
+	}
+
+	if (total < size)
+	{	flag |= 0x06;
+	}
+
+	return total == size;
+}
+
+
 // Accepts a new connection using the hosting socket
 // If the connection fails, returns an empty socket
 XSocket* XSocket::Accept()
@@ -265,6 +611,8 @@ XSocket* XSocket::Accept()
 	return new XSocket();
 }
 
+#endif
+
 
 // Opens a new connection with the address specified
 // Only applicable to interfaces that manage a socket
@@ -278,10 +626,10 @@ void IXSocket::Open(int _type, const str _addr, int _port, int _ctime)
 
 // Hosts a new server using the currently managed socket
 // Only applicable to interfaces that manage a socket
-void IXSocket::Host(int _type, int _port)
+void IXSocket::Host(int _type, int _port, int _backlog)
 {
 	if (xsocket != NULL)
-	{	xsocket->Host(_type, _port);
+	{	xsocket->Host(_type, _port, _backlog);
 	}
 }
 
@@ -300,18 +648,43 @@ IXSocket IXSocket::Accept()
 }
 
 
-void IXSocket::Send(const str data, const int size, const sockaddr_in address)
+void IXSocket::Send(const str& data, const int size, const sockaddr_in address)
 {
 	if (xsocket != NULL)
 		xsocket->Send(data, size, address);
 }
 
-void IXSocket::Send(const str data, const int size)
+void IXSocket::Send(const str& data, const int size)
 {
 	if (xsocket != NULL)
 		xsocket->Send(data, size);
 }
 
+void IXSocket::Send(const XSlice* slices, const int count)
+{
+	if (xsocket != NULL)
+		xsocket->Send(slices, count);
+}
+
+long IXSocket::Write(const XSlice* slices, const int count, const size_t offset, const int timeout)
+{
+	if (xsocket != NULL)
+		return xsocket->Write(slices, count, offset, timeout);
+	return -1;
+}
+
+void IXSocket::ZeroCopy(const int threshold)
+{
+	if (xsocket != NULL)
+		xsocket->ZeroCopy(threshold);
+}
+
+void IXSocket::Timeout(const int timeout)
+{
+	if (xsocket != NULL)
+		xsocket->Timeout(timeout);
+}
+
 str IXSocket::Recv(sockaddr_in* address, const int size = 256)
 {
 	if (xsocket != NULL)
@@ -319,6 +692,13 @@ str IXSocket::Recv(sockaddr_in* address, const int size = 256)
 	return "";
 }
 
+bool IXSocket::Read(char* buffer, const int size)
+{
+	if (xsocket != NULL)
+		return xsocket->Read(buffer, size);
+	return false;
+}
+
 
 // Returns true if the managed socket is working as intended
 // Interfaces returning false must be discarded
@@ -340,18 +720,14 @@ bool IXSocket::good()
 
 #pragma region Cleaning
 
-// Closes the socket, clears messages and stops every running process
+#ifdef _WIN32
+// Closes the socket and clears messages
 void XSocket::Close()
 {
-	if (connectThr != NULL)
-	{	TerminateThread(connectThr, -1);
-	}
-
 	if (socketObj != INVALID_SOCKET)
 	{	closesocket(socketObj);
 	}
 
-	this->connectThr = NULL;
 	this->socketObj  = INVALID_SOCKET;
 
 	this->addr  = "";
@@ -361,6 +737,27 @@ void XSocket::Close()
 	this->flag |= 0x0E;
 }
 
+// Stops receiving on the socket, and sending too if sends are stopped,
+// waking the threads blocked on it
+// A blocking accept is only woken by closing the socket, so hosting sockets
+// are closed instead
+void XSocket::Shutdown(const bool sends)
+{
+	if (socketObj == INVALID_SOCKET)
+	{	return;
+	}
+
+	if (host)
+	{	closesocket(socketObj);
+		socketObj = INVALID_SOCKET;
+	}
+	else
+	{	shutdown(socketObj, sends ? SD_BOTH : SD_RECEIVE);
+	}
+}
+
+#endif
+
 // Closes the XSocket
 void IXSocket::Close()
 {
@@ -369,6 +766,14 @@ void IXSocket::Close()
 	}
 }
 
+// Stops receiving on the XSocket, sends can still complete unless stopped too
+void IXSocket::Shutdown(const bool sends)
+{
+	if (xsocket != NULL)
+	{	xsocket->Shutdown(sends);
+	}
+}
+
 // Closes the XSocket and frees memory allocation
 void IXSocket::Delete()
 {
@@ -0,0 +1,600 @@
+#include <rpc-service/XSocket.h>
+#include <rpc-service/XBuffer.h>
+
+#ifndef _WIN32
+
+#include <netinet/tcp.h>
+#include <linux/errqueue.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+
+#pragma region Constructors
+
+// Creates an empty socket with placeholder values
+XSocket::XSocket()
+{
+	this->socketObj  = INVALID_SOCKET;
+	this->pollObj    = -1;
+
+	this->flag  = 0xFF;
+	this->addr  = "";
+	this->host  = false;
+	this->port  = 0;
+	this->type  = 0;
+	this->ctime = 0;
+	this->rtime = 0;
+	this->backlog  = 0;
+	this->zeroCopy = 0;
+}
+
+
+// Creates a socket from a connected socket and an address
+// Extracts IP and Port from the address structure
+// The socket is expected to be in non-blocking mode already
+XSocket::XSocket(const SOCKET socket, const sockaddr_in addrinf)
+{
+	this->socketObj  = socket;
+	this->pollObj    = epoll_create1(EPOLL_CLOEXEC);
+	this->addrInfo   = addrinf;
+
+	this->flag  = pollObj != -1 ? 0xF8 : 0xFE;
+	this->host  = false;
+	this->type  = TCP;
+	this->ctime = 0;
+	this->rtime = 0;
+	this->backlog  = 0;
+	this->zeroCopy = 0;
+
+	char ip[INET_ADDRSTRLEN] = "";
+	inet_ntop(AF_INET, &addrInfo.sin_addr, ip, sizeof(ip));
+
+	this->addr = ip;
+	this->port = ntohs(addrInfo.sin_port);
+
+	if (pollObj != -1)
+	{	epoll_event ev = epoll_event{};
+		ev.data.fd = socketObj;
+		epoll_ctl(pollObj, EPOLL_CTL_ADD, socketObj, &ev);
+	}
+
+	int nodelay = 1;
+	setsockopt(socketObj, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+}
+
+#pragma endregion
+
+
+#pragma region Methods
+
+// Adds the socket to the epoll instance watching it, creating the instance if needed
+// Clears the socket error flag if it succeeds
+static bool watchSocket(XSocket* XS)
+{
+	if (XS->pollObj == -1)
+	{	XS->pollObj = epoll_create1(EPOLL_CLOEXEC);
+	}
+
+	epoll_event ev = epoll_event{};
+	ev.data.fd = XS->socketObj;
+	if (XS->pollObj == -1 || 0 != epoll_ctl(XS->pollObj, EPOLL_CTL_ADD, XS->socketObj, &ev))
+	{	return false;
+	}
+
+	XS->flag &= 0xFD;
+	return true;
+}
+
+
+// Creates a non-blocking socket of the type requested and an epoll instance watching it
+// Clears the socket error flag if both succeed
+static bool makeSocket(XSocket* XS)
+{
+	auto inf_socket   = XS->type == TCP ? SOCK_STREAM : SOCK_DGRAM;
+	auto inf_protocol = XS->type == TCP ? IPPROTO_TCP : IPPROTO_UDP;
+
+	XS->socketObj = socket(AF_INET, inf_socket | SOCK_NONBLOCK | SOCK_CLOEXEC, inf_protocol);
+	if (XS->socketObj == INVALID_SOCKET)
+	{	return false;
+	}
+
+	return watchSocket(XS);
+}
+
+
+// Blocks the thread until the socket is ready for the events specified
+// Timeout is in milliseconds, negative values wait indefinitely
+// Returns false on timeout or if the epoll instance failed
+bool XSocket::Wait(const uint events, const int timeout)
+{
+	epoll_event ev = epoll_event{};
+	ev.events  = events;
+	ev.data.fd = socketObj;
+
+	if (pollObj == -1 || 0 != epoll_ctl(pollObj, EPOLL_CTL_MOD, socketObj, &ev))
+	{	return false;
+	}
+
+	int ready = 0;
+	do
+	{	ready = epoll_wait(pollObj, &ev, 1, timeout);
+	} while (ready < 0 && errno == EINTR);
+
+	return ready > 0;
+}
+
+
+//Constructs the socket with the given parameters and opens the connection.
+//If the process encounters an error, error flags are set, and the process halts.
+//Every address of the host is tried, refused ones again until the timeout in
+//milliseconds has passed. The connection is made without blocking.
+//Successful connection leaves all 3 flags at 0, meaning flag|0x07 is 0.
+void XSocket::Open(const int _type, const str _addr, const int _port, const int _ctime = XSOCKET_CTIME)
+{
+	Close();
+
+	this->addr = _addr;
+	this->port = _port;
+	this->type = _type;
+	this->ctime = _ctime;
+	this->host = false;
+	this->flag |= 0x0E;
+	this->flag &= 0xFE;
+
+	std::vector<XAddress> addresses = XResolve(addr, port, type);
+
+	// Datagrams are sent to the first IPv4 address
+	addrInfo = sockaddr_in{};
+	for (size_t i = 0; i < addresses.size(); i++)
+	{	if (addresses[i].address.ss_family == AF_INET)
+		{	memcpy(&addrInfo, &addresses[i].address, sizeof(addrInfo));
+			break;
+		}
+	}
+
+	if (type == UDP)
+	{	if (addrInfo.sin_family == AF_INET)
+		{	makeSocket(this);
+		}
+		return;
+	}
+
+	size_t used = 0;
+	socketObj = XConnect(addresses, ctime, &used);
+	if (socketObj == INVALID_SOCKET || !watchSocket(this))
+	{	flag |= 0x02;
+		return;
+	}
+
+	if (addresses[used].address.ss_family == AF_INET)
+	{	memcpy(&addrInfo, &addresses[used].address, sizeof(addrInfo));
+	}
+
+	int nodelay = 1;
+	setsockopt(socketObj, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+	flag &= 0xFB;
+}
+
+
+//Constructs the socket with the given parameters and starts listening.
+//If the process encounters an error, error flags are set, and the process halts.
+//The address is shared with SO_REUSEPORT so several services can balance a port.
+void XSocket::Host(int _type, int _port, int _backlog)
+{
+	Close();
+
+	this->addr = "0.0.0.0";
+	this->port = _port;
+	this->type = _type;
+	this->ctime = 0;
+	this->backlog = _backlog;
+	this->host = true;
+	this->flag |= 0x0E;
+	this->flag &= 0xFE;
+
+	addrInfo = sockaddr_in{};
+	addrInfo.sin_family = AF_INET;
+	addrInfo.sin_port = htons(port);
+	addrInfo.sin_addr.s_addr = inet_addr(addr.data());
+
+	if (!makeSocket(this))
+	{	return;
+	}
+
+	int reuse = 1;
+	setsockopt(socketObj, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	setsockopt(socketObj, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse));
+
+	if ((flag & 0x0F) == 12 && type == TCP)
+	{	if (0 == bind(socketObj, (struct sockaddr *) &addrInfo, sizeof(addrInfo)))
+			if (0 == listen(socketObj, backlog))
+				flag &= 0xF7;
+	}
+	else if ((flag & 0x0F) == 12 && type == UDP)
+	{	if (0 == bind(socketObj, (struct sockaddr *) &addrInfo, sizeof(addrInfo)))
+			flag &= 0xF3;
+	}
+}
+
+
+//If the connection is successfully established, sends a C-String with a size to the receiver.
+//Partial writes are continued once the socket becomes writable again.
+//If an error occurs, it raises the connection and the socket error flags.
+void XSocket::Send(const str& data, const int size)
+{
+	ssize_t sent = 0;
+	int total = 0;
+
+	if (type == UDP && (flag & 0x03) == 0 && data != "")
+	{	sockaddr_in address = addrInfo;
+		Send(data, size, address);
+		return;
+	}
+
+	if (type == TCP && (flag & 0x07) == 0 && data != "")
+	{
+		while (total < size)
+		{	sent = send(socketObj, data.data() + total, size - total, MSG_NOSIGNAL);
+
+			if (sent > 0)
+			{	total += (int)sent;
+			}
+			else if (sent < 0 && errno == EINTR)
+			{	continue;
+			}
+			else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && Wait(EPOLLOUT, -1))
+			{	continue;
+			}
+			else
+			{	break;
+			}
+		}
+	}
+
+	if (total < 1 || total < size)
+		flag |= 0x06;
+}
+
+
+//Sends the slices one after the other as a single stream with as few calls as possible
+//Partial writes are continued from the first byte that was not sent, once the
+//socket becomes writable again. Sends of at least zeroCopy bytes are made with
+//MSG_ZEROCOPY, and return once the kernel is done with the memory of the slices.
+//If an error occurs, it raises the connection and the socket error flags.
+void XSocket::Send(const XSlice* slices, const int count)
+{
+	size_t total = 0;
+	size_t sent  = 0;
+
+	for (int i = 0; i < count; i++)
+	{	total += slices[i].size;
+	}
+
+	while (type == TCP && (flag & 0x07) == 0)
+	{
+		long written = Write(slices, count, sent, -1);
+		if (written < 0)
+		{	return;
+		}
+
+		sent += (size_t)written;
+		if (sent == total || !Wait(EPOLLOUT, -1))
+		{	break;
+		}
+	}
+
+	if (sent < total)
+	{	flag |= 0x06;
+	}
+}
+
+
+//Writes the slices from the offset as far as the socket takes them, without
+//waiting for room. Writes of at least zeroCopy bytes are made with MSG_ZEROCOPY,
+//and wait up to timeout milliseconds for the kernel to be done with the memory
+//of the slices, or forever if negative.
+//Returns the number of bytes written, or -1 if an error occurs before any
+//byte was written. Errors raise the connection and the socket error flags.
+long XSocket::Write(const XSlice* slices, const int count, const size_t offset, const int timeout)
+{
+	int    first   = 0;
+	size_t skip    = offset;
+	size_t total   = 0;
+	long   written = 0;
+	int    copies  = 0;
+
+	for (int i = 0; i < count; i++)
+	{	total += slices[i].size;
+	}
+
+#ifdef MSG_ZEROCOPY
+	int zero = zeroCopy > 0 && total - offset >= (size_t)zeroCopy ? MSG_ZEROCOPY : 0;
+#else
+	int zero = 0;
+#endif
+
+	while (type == TCP && (flag & 0x07) == 0)
+	{
+		while (first < count && slices[first].size <= skip)
+		{	skip -= slices[first].size;
+			first++;
+		}
+
+		if (first == count)
+		{	break;
+		}
+
+		iovec  iov[XSOCKET_SLICES];
+		size_t used = 0;
+
+		for (int i = first; i < count && used < XSOCKET_SLICES; i++, used++)
+		{	size_t from = i == first ? skip : 0;
+			iov[used].iov_base = (void*)(slices[i].data + from);
+			iov[used].iov_len  = slices[i].size - from;
+		}
+
+		msghdr msg = msghdr{};
+		msg.msg_iov    = iov;
+		msg.msg_iovlen = used;
+
+		ssize_t sent = sendmsg(socketObj, &msg, MSG_NOSIGNAL | MSG_DONTWAIT | zero);
+
+		if (sent < 0 && errno == EINTR)
+		{	continue;
+		}
+		if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{	break;
+		}
+		if (sent < 0 && errno == ENOBUFS && zero != 0)
+		{	zero = 0;
+			continue;
+		}
+		if (sent <= 0)
+		{	flag |= 0x06;
+			break;
+		}
+
+		if (zero != 0)
+		{	copies++;
+		}
+
+		written += (long)sent;
+		skip    += (size_t)sent;
+	}
+
+	if (copies > 0 && !Reap(copies, timeout))
+	{	flag |= 0x06;
+	}
+
+	return (flag & 0x07) != 0 && written == 0 ? -1 : written;
+}
+
+
+// Waits for the kernel to be done with the memory of the zero-copy sends
+// Completions are read from the error queue of the socket, waiting up to
+// timeout milliseconds for each, or forever if negative
+// Returns false if the socket failed or timed out before every send completed
+bool XSocket::Reap(const int sends, const int timeout)
+{
+	int done = 0;
+
+	while (done < sends)
+	{
+		char   control[128];
+		msghdr msg = msghdr{};
+		msg.msg_control    = control;
+		msg.msg_controllen = sizeof(control);
+
+		if (recvmsg(socketObj, &msg, MSG_ERRQUEUE) < 0)
+		{	if (errno == EINTR || ((errno == EAGAIN || errno == EWOULDBLOCK) && Wait(EPOLLERR, timeout)))
+			{	continue;
+			}
+			return false;
+		}
+
+		for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm))
+		{	if (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+			{	sock_extended_err* err = (sock_extended_err*)CMSG_DATA(cm);
+				if (err->ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+				{	done += (int)(err->ee_data - err->ee_info + 1);
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+
+// Sends of at least threshold bytes are made without copying the data
+// Disabled if the threshold is not positive or the system doesn't support it
+void XSocket::ZeroCopy(const int threshold)
+{
+	zeroCopy = 0;
+
+#ifdef SO_ZEROCOPY
+	int enabled = 1;
+	if (threshold > 0 && 0 == setsockopt(socketObj, SOL_SOCKET, SO_ZEROCOPY, &enabled, sizeof(enabled)))
+	{	zeroCopy = threshold;
+	}
+#endif
+}
+
+
+// Reads fail once no data arrived for timeout milliseconds, leaving the
+// connection in error. Reads wait forever if the timeout is not positive.
+void XSocket::Timeout(const int timeout)
+{	rtime = timeout > 0 ? timeout : 0;
+}
+
+
+//If the connection is successfully established, sends a C-String with a size to the receiver.
+//If an error occurs, it raises the connection and the socket error flags.
+void XSocket::Send(const str& data, const int size, const sockaddr_in address)
+{
+	ssize_t sent = 0;
+
+	if (type == UDP && (flag & 0x03) == 0 && data != "")
+	{
+		do
+		{	sent = sendto(socketObj, data.data(), size, MSG_NOSIGNAL, (struct sockaddr *) &address, sizeof(address));
+		} while (sent < 0 && (errno == EINTR || ((errno == EAGAIN || errno == EWOULDBLOCK) && Wait(EPOLLOUT, -1))));
+
+		if (sent > 0)
+			flag &= 0xFB;
+	}
+
+	if (sent < 1)
+		flag |= 0x06;
+}
+
+
+// Blocks the thread untill there is a message in the queue and returns it
+// Sets the address when using datagrams
+// Returns empty string on failure
+// The message is received straight into a pooled buffer
+str XSocket::Recv(sockaddr_in* address, const int maxSize = 256)
+{
+	socklen_t addrlen = sizeof(sockaddr_in);
+	str result = Buffers().Acquire(maxSize);
+	result.resize(maxSize);
+
+	ssize_t received = 0;
+	char* buffer = &result[0];
+
+	for (;;)
+	{
+		if (type == UDP)
+		{	received = recvfrom(socketObj, buffer, maxSize, 0, (struct sockaddr*) address, (address != NULL ? &addrlen : NULL));
+		}
+		else if (type == TCP)
+		{	received = recv(socketObj, buffer, maxSize, 0);
+		}
+
+		if (received < 0 && errno == EINTR)
+		{	continue;
+		}
+		if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && Wait(EPOLLIN, -1))
+		{	continue;
+		}
+		break;
+	}
+
+	if (received > 0)
+	{	result.resize(received);
+	}
+	else
+	{	result.clear();
+		flag |= 0x06;
+	}
+
+	return result;
+}
+
+
+// Blocks the thread untill exactly size bytes are received into the buffer
+// Only applicable to TCP sockets
+// Returns false and sets the error flags on failure
+bool XSocket::Read(char* buffer, const int size)
+{
+	int total = 0;
+
+	while (type == TCP && (flag & 0x07) == 0 && total < size)
+	{	ssize_t received = recv(socketObj, buffer + total, size - total, 0);
+
+		if (received > 0)
+		{	total += (int)received;
+		}
+		else if (received < 0 && errno == EINTR)
+		{	continue;
+		}
+		else if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && Wait(EPOLLIN, rtime > 0 ? rtime : -1))
+		{	continue;
+		}
+		else
+		{	break;
+		}
+	}
+
+	if (total < size)
+	{	flag |= 0x06;
+	}
+
+	return total == size;
+}
+
+
+// Accepts a new connection using the hosting socket
+// Blocks the thread until a connection is pending
+// If the connection fails, returns an empty socket
+XSocket* XSocket::Accept()
+{
+	SOCKET s = INVALID_SOCKET;
+	sockaddr_in clInfo;
+	socklen_t addrlen = sizeof(clInfo);
+
+	if (type != TCP || (flag & 0x0F) != 4)
+	{	return new XSocket();
+	}
+
+	for (;;)
+	{	s = accept4(socketObj, (struct sockaddr *)&clInfo, &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+		if (s == INVALID_SOCKET && (errno == EINTR || errno == ECONNABORTED))
+		{	continue;
+		}
+		if (s == INVALID_SOCKET && (errno == EAGAIN || errno == EWOULDBLOCK) && Wait(EPOLLIN, -1))
+		{	continue;
+		}
+		break;
+	}
+
+	if (s != INVALID_SOCKET)
+	{	return new XSocket(s, clInfo);
+	}
+
+	return new XSocket();
+}
+
+#pragma endregion
+
+
+#pragma region Cleaning
+
+// Closes the socket and the epoll instance watching it
+void XSocket::Close()
+{
+	if (socketObj != INVALID_SOCKET)
+	{	close(socketObj);
+	}
+
+	if (pollObj != -1)
+	{	close(pollObj);
+	}
+
+	this->socketObj  = INVALID_SOCKET;
+	this->pollObj    = -1;
+
+	this->addr  = "";
+	this->port  = 0;
+	this->type  = 0;
+	this->ctime = 0;
+	this->flag |= 0x0E;
+}
+
+// Stops receiving on the socket, waking the threads blocked reading from it
+// Reads then fail and a blocking accept returns, while sends can still
+// complete unless sends are stopped as well
+void XSocket::Shutdown(const bool sends)
+{
+	if (socketObj != INVALID_SOCKET)
+	{	shutdown(socketObj, sends ? SHUT_RDWR : SHUT_RD);
+	}
+}
+
+#pragma endregion
+
+#endif
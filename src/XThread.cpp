@@ -0,0 +1,333 @@
+#include <rpc-service/XThread.h>
+
+#ifdef _WIN32
+
+// Starts a Win32 thread with the default stack size
+void* XCreateThread(XThreadFn function, void* parameter)
+{	return CreateThread(NULL, 0, function, parameter, 0, NULL);
+}
+
+// Terminates the Win32 thread
+void XTerminateThread(void* thread)
+{	TerminateThread(thread, 0);
+	CloseHandle(thread);
+}
+
+// Waits for the Win32 thread to be signaled
+bool XWaitThread(void* thread, int timeout)
+{	return thread != NULL && WAIT_OBJECT_0 == WaitForSingleObject(thread, timeout < 0 ? INFINITE : (DWORD)timeout);
+}
+
+// Closes the handle of the Win32 thread
+void XReleaseThread(void* thread)
+{	if (thread != NULL)
+	{	CloseHandle(thread);
+	}
+}
+
+#else
+
+#include <pthread.h>
+#include <chrono>
+#include <mutex>
+
+// State of a thread shared between the thread and the handle owner
+// Threads run detached, so the state tells whether cancelling is still safe
+struct XThreadState
+{
+	pthread_t  id;				// Identifier of the thread
+	XThreadFn  function;		// Function running in the thread
+	void*      parameter;		// Parameter of the function
+	std::mutex lock;			// Guards the fields below
+	std::condition_variable ended;	// Wakes the threads waiting for the function to return
+	bool       done;			// Flag of wether the function has returned
+	int        refs;			// Number of owners of the state
+};
+
+// Drops one reference to the thread state and frees it with the last one
+static void releaseState(XThreadState* state)
+{
+	bool last = false;
+	{	std::lock_guard<std::mutex> guard(state->lock);
+		last = --state->refs == 0;
+	}
+
+	if (last)
+	{	delete state;
+	}
+}
+
+// Marks the thread finished when the function returns or the thread is cancelled
+struct XThreadExit
+{
+	XThreadState* state;
+
+	~XThreadExit()
+	{	{	std::lock_guard<std::mutex> guard(state->lock);
+			state->done = true;
+			state->ended.notify_all();
+		}
+		releaseState(state);
+	}
+};
+
+// Runs the thread function with the Win32-like signature
+static void* threadFn(void* parameter)
+{
+	XThreadState* state = (XThreadState*)parameter;
+	XThreadExit exit = { state };
+
+	state->function(state->parameter);
+	return NULL;
+}
+
+// Starts a detached POSIX thread
+void* XCreateThread(XThreadFn function, void* parameter)
+{
+	XThreadState* state = new XThreadState();
+	state->function  = function;
+	state->parameter = parameter;
+	state->done = false;
+	state->refs = 2;
+
+	if (0 != pthread_create(&state->id, NULL, threadFn, state))
+	{	delete state;
+		return NULL;
+	}
+
+	pthread_detach(state->id);
+	return state;
+}
+
+// Cancels the POSIX thread if it's still running
+// The thread stops at its next cancellation point such as a blocking wait
+void XTerminateThread(void* thread)
+{
+	XThreadState* state = (XThreadState*)thread;
+	if (state == NULL)
+	{	return;
+	}
+
+	{	std::lock_guard<std::mutex> guard(state->lock);
+		if (!state->done)
+		{	pthread_cancel(state->id);
+		}
+	}
+
+	releaseState(state);
+}
+
+// Waits on the thread state until the function has returned
+bool XWaitThread(void* thread, int timeout)
+{
+	XThreadState* state = (XThreadState*)thread;
+	if (state == NULL)
+	{	return false;
+	}
+
+	std::unique_lock<std::mutex> guard(state->lock);
+	if (timeout < 0)
+	{	state->ended.wait(guard, [state]() { return state->done; });
+		return true;
+	}
+
+	return state->ended.wait_for(guard, std::chrono::milliseconds(timeout), [state]() { return state->done; });
+}
+
+// Drops the handle's reference to the thread state
+void XReleaseThread(void* thread)
+{
+	if (thread != NULL)
+	{	releaseState((XThreadState*)thread);
+	}
+}
+
+#endif
+
+
+// Pool and queue of the worker running on the current thread, if any
+// Lets a worker post to its own queue
+static thread_local XThreadPool* currentPool  = NULL;
+static thread_local size_t       currentQueue = 0;
+
+
+// Creates a pool with no workers
+XThreadPool::XThreadPool() : queued(0), next(0), sleeping(0), blocked(0), capacity(0), running(false) {}
+
+// Stops the workers of the pool and frees their queues
+XThreadPool::~XThreadPool()
+{	Stop();
+
+	for (size_t i = 0; i < queues.size(); i++)
+	{	delete queues[i];
+	}
+}
+
+// Starts the number of worker threads specified, each with its own queue
+// Uses one worker per hardware thread if the number is not positive
+// At most capacity tasks wait in the queues, unless it is 0
+bool XThreadPool::Start(int threads, size_t capacity)
+{
+	Stop();
+
+	if (threads < 1)
+	{	threads = (int)std::thread::hardware_concurrency();
+	}
+	if (threads < 1)
+	{	threads = 1;
+	}
+
+	for (size_t i = 0; i < queues.size(); i++)
+	{	delete queues[i];
+	}
+
+	queues.clear();
+	for (int i = 0; i < threads; i++)
+	{	queues.push_back(new XWorkQueue());
+	}
+
+	this->capacity = capacity;
+	queued  = 0;
+	running = true;
+
+	for (int i = 0; i < threads; i++)
+	{	workers.push_back(std::thread(&XThreadPool::Loop, this, (size_t)i));
+	}
+
+	return true;
+}
+
+// Queues a task for the workers
+// If the queues are full, waits up to timeout milliseconds for room
+// Returns false if the pool is not running or the queues stayed full
+bool XThreadPool::Post(std::function<void()> task, int timeout)
+{
+	if (!Reserve(timeout))
+	{	return false;
+	}
+
+	size_t index = currentPool == this ? currentQueue : next++ % queues.size();
+	{	std::lock_guard<std::mutex> guard(queues[index]->lock);
+		queues[index]->tasks.push_back(std::move(task));
+	}
+
+	if (sleeping > 0)
+	{	std::lock_guard<std::mutex> guard(lock);
+		signal.notify_one();
+	}
+	return true;
+}
+
+// Counts a task about to be queued
+// Waits up to timeout milliseconds for room if the queues are full
+// Returns false if the pool is not running or there was no room
+bool XThreadPool::Reserve(int timeout)
+{
+	auto reserve = [this]()
+	{	size_t count = queued++;
+		if (capacity == 0 || count < capacity)
+		{	return true;
+		}
+		queued--;
+		return false;
+	};
+
+	std::unique_lock<std::mutex> guard(lock);
+	if (!running)
+	{	return false;
+	}
+	if (reserve())
+	{	return true;
+	}
+	if (timeout <= 0)
+	{	return false;
+	}
+
+	blocked++;
+	bool reserved = room.wait_for(guard, std::chrono::milliseconds(timeout), [this, &reserve]()
+	{	return !running || reserve();
+	});
+	blocked--;
+
+	return reserved && running;
+}
+
+// Stops the workers after their current task and drops the queued tasks
+// without running them. The queues are kept until the pool restarts, so a
+// task posted while the pool stops is dropped as well.
+void XThreadPool::Stop()
+{
+	{	std::lock_guard<std::mutex> guard(lock);
+		running = false;
+	}
+	signal.notify_all();
+	room.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++)
+	{	if (workers[i].joinable())
+		{	workers[i].join();
+		}
+	}
+
+	for (size_t i = 0; i < queues.size(); i++)
+	{	std::lock_guard<std::mutex> guard(queues[i]->lock);
+		queues[i]->tasks.clear();
+	}
+
+	workers.clear();
+	queued = 0;
+}
+
+// Takes the oldest task of the worker's queue, or steals the newest task of
+// another queue if it's empty
+// Returns false if every queue is empty
+bool XThreadPool::Take(size_t index, std::function<void()>& task)
+{
+	for (size_t i = 0; i < queues.size(); i++)
+	{	XWorkQueue* queue = queues[(index + i) % queues.size()];
+		std::lock_guard<std::mutex> guard(queue->lock);
+
+		if (!queue->tasks.empty())
+		{	if (i == 0)
+			{	task = std::move(queue->tasks.front());
+				queue->tasks.pop_front();
+			}
+			else
+			{	task = std::move(queue->tasks.back());
+				queue->tasks.pop_back();
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+// Executes tasks from the queues until the pool is stopped
+// Sleeps while there are no tasks to take. Once stopped, no other task is
+// taken, and the ones still queued are dropped by Stop.
+void XThreadPool::Loop(size_t index)
+{
+	currentPool  = this;
+	currentQueue = index;
+
+	while (running)
+	{
+		std::function<void()> task;
+
+		if (Take(index, task))
+		{	queued--;
+			if (blocked > 0)
+			{	std::lock_guard<std::mutex> guard(lock);
+				room.notify_one();
+			}
+
+			task();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> guard(lock);
+		sleeping++;
+		signal.wait(guard, [this] { return !running || queued > 0; });
+		sleeping--;
+	}
+}
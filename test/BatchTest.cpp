@@ -0,0 +1,106 @@
+#include <rpc-service/RPCService.h>
+#include <rpc-service/RPCClient.h>
+#include <rpc-service/RPCFunction.h>
+#include "RPCTest.h"
+
+#include <chrono>
+#include <thread>
+
+// Ports of the services started by the test
+#define BATCH_PORT 7651
+
+typedef std::chrono::steady_clock clk;
+
+float Divide(int a, int b)
+{	return (float)a / b;
+}
+
+str Echo(str data)
+{	return data;
+}
+
+// Sleeps for the milliseconds given and returns them
+int Nap(int ms)
+{	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+	return ms;
+}
+
+static auto functions = std::make_tuple(
+	MakeFunction("Divide", Type<float>(), Divide, std::tuple<Type<int>, Type<int> >()),
+	MakeFunction("Echo", Type<str>(), Echo, std::tuple<Type<str> >()),
+	MakeFunction("Nap", Type<int>(), Nap, std::tuple<Type<int> >())
+);
+
+
+// Every call of a batch gets its own result in order, and a failed call
+// doesn't fail the others
+static void results(int port, bool compact, bool parallel)
+{
+	RPCClient client;
+	client.compact = compact;
+
+	RPCBatch batch = client.Batch("127.0.0.1", port);
+	for (int i = 0; i < 100; i++)
+	{	batch.Call("Divide", i, 4);
+	}
+	batch.Call("Missing", 1).Call("Echo", str("last")).Parallel(parallel);
+
+	RPCReplies replies = batch.Send();
+	CHECK(replies.ok);
+	CHECK(replies.size() == 102);
+
+	float quotient = 0;
+	for (int i = 0; i < 100; i++)
+	{	CHECK(replies.Get(i, quotient) && quotient == i / 4.0f);
+	}
+
+	str echoed;
+	CHECK(!replies.good(100));
+	CHECK(replies.Get(101, echoed) && echoed == "last");
+
+	// The same batch sent asynchronously
+	RPCResult<RPCReplies> later = batch.Async().get();
+	CHECK(later.ok && later.value.size() == 102);
+	CHECK(later.value.Get(3, quotient) && quotient == 0.75f);
+}
+
+// The calls of a parallel batch run on the workers at the same time
+static void parallel(int port)
+{
+	RPCClient client;
+	RPCBatch batch = client.Batch("127.0.0.1", port);
+	batch.Call("Nap", 200).Call("Nap", 200).Call("Nap", 200).Call("Nap", 200).Parallel();
+
+	auto begun = clk::now();
+	RPCReplies replies = batch.Send();
+	CHECK(clk::now() - begun < std::chrono::milliseconds(600));
+
+	int slept = 0;
+	CHECK(replies.ok && replies.size() == 4);
+	CHECK(replies.Get(3, slept) && slept == 200);
+}
+
+// Serves the batches in the mode given, in both encodings
+static void serve(int port, int ioThreads, int workerThreads)
+{
+	auto service = MakeIRPCService(functions);
+	CHECK(service.Start(port, ioThreads, workerThreads));
+
+	results(port, false, false);
+	results(port, true, false);
+	results(port, false, true);
+	results(port, true, true);
+
+	if (ioThreads > 0)
+	{	parallel(port);
+	}
+
+	service.Delete();
+}
+
+int main()
+{
+	RUN(serve(BATCH_PORT, 0, 0));
+	RUN(serve(BATCH_PORT + 1, 1, 4));
+	return RESULT();
+}
@@ -0,0 +1,172 @@
+#include <rpc-service/RPCService.h>
+#include <rpc-service/RPCClient.h>
+#include <rpc-service/RPCFunction.h>
+#include "RPCTest.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// Ports of the services started by the test
+#define CACHE_PORT 7611
+
+// Number of times the functions ran
+static std::atomic<int> runs(0);
+
+str Square(int a)
+{	runs++;
+	return std::to_string(a * a) + str(1000, ' ');
+}
+
+int Plain(int a)
+{	runs++;
+	return a;
+}
+
+// Names whose ids collide, which keep a service from starting
+int Left(int a)
+{	runs++;
+	return a;
+}
+
+int Right(int a)
+{	runs++;
+	return -a;
+}
+
+static auto functions = std::make_tuple(
+	MakeFunction("Square", Type<str>(), Square, std::tuple<Type<int> >(), true),
+	MakeFunction("Plain", Type<int>(), Plain, std::tuple<Type<int> >())
+);
+
+static auto colliding = std::make_tuple(
+	MakeFunction("Plain", Type<int>(), Plain, std::tuple<Type<int> >()),
+	MakeFunction("Fn112789", Type<int>(), Left, std::tuple<Type<int> >(), true),
+	MakeFunction("Fn349192", Type<int>(), Right, std::tuple<Type<int> >(), true)
+);
+
+// Returns the counters of the function, which the service has
+template<class Service>
+static RPCProcedureStats stats(Service& service, const str& name)
+{	std::vector<RPCProcedureStats> all = service.Stats();
+	size_t i = 0;
+	while (i + 1 < all.size() && all[i].name != name)
+	{	i++;
+	}
+	return all[i];
+}
+
+// Repeated calls of a cacheable function run it once per parameters
+static void hits(int port)
+{
+	auto service = MakeIRPCService(functions);
+	CHECK(service.Start(port, 1, 2));
+	runs = 0;
+
+	RPCClient client;
+	str reply;
+	for (int i = 0; i < 5; i++)
+	{	CHECK(client.Call("127.0.0.1", port, reply, "Square", 7));
+		CHECK(reply.substr(0, 2) == "49");
+	}
+	CHECK(runs == 1);
+
+	CHECK(client.Call("127.0.0.1", port, reply, "Square", 8));
+	CHECK(reply.substr(0, 2) == "64");
+	CHECK(runs == 2);
+
+	// The compact encoding has replies of its own
+	client.compact = true;
+	CHECK(client.Call("127.0.0.1", port, reply, "Square", 7));
+	CHECK(reply.substr(0, 2) == "49");
+	CHECK(runs == 3);
+
+	int value = 0;
+	for (int i = 0; i < 3; i++)
+	{	CHECK(client.Call("127.0.0.1", port, value, "Plain", 1));
+	}
+	CHECK(runs == 6);
+
+	RPCProcedureStats square = stats(service, "Square");
+	CHECK(square.calls == 7 && square.hits == 4 && square.misses == 3);
+	CHECK(stats(service, "Plain").hits == 0 && stats(service, "Plain").misses == 0);
+
+	service.Delete();
+}
+
+// Replies go stale after the time to live
+static void expiry(int port)
+{
+	auto service = MakeIRPCService(functions);
+	service.Cache(1 << 20, 50);
+	CHECK(service.Start(port, 1, 2));
+	runs = 0;
+
+	RPCClient client;
+	str reply;
+	CHECK(client.Call("127.0.0.1", port, reply, "Square", 3));
+	CHECK(client.Call("127.0.0.1", port, reply, "Square", 3));
+	CHECK(runs == 1);
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(80));
+	CHECK(client.Call("127.0.0.1", port, reply, "Square", 3));
+	CHECK(runs == 2);
+
+	service.Delete();
+}
+
+// The least recently used replies are evicted once the cache is full
+static void eviction(int port)
+{
+	auto service = MakeIRPCService(functions);
+	service.Cache(CACHE_SHARDS * 4000);
+	CHECK(service.Start(port, 1, 2));
+	runs = 0;
+
+	RPCClient client;
+	str reply;
+	for (int i = 0; i < 500; i++)
+	{	CHECK(client.Call("127.0.0.1", port, reply, "Square", i));
+	}
+	CHECK(runs == 500);
+
+	// About 3 replies fit in each shard, so nearly every call runs again
+	for (int i = 0; i < 500; i++)
+	{	CHECK(client.Call("127.0.0.1", port, reply, "Square", i));
+	}
+	CHECK(runs > 900);
+
+	service.Delete();
+}
+
+// A service whose functions' ids collide doesn't start, and names them
+static void collisions(int port)
+{
+	static_assert(MethodId("Fn112789") == MethodId("Fn349192"), "the names must collide");
+
+	auto service = MakeIRPCService(colliding);
+	CHECK(!service.Start(port, 1, 2));
+	CHECK(!service.Start(port));
+
+	std::vector<str> names = service.Collisions();
+	CHECK(names.size() == 2 && names[0] == "Fn112789" && names[1] == "Fn349192");
+
+	int value = 0;
+	CHECK(!RPC("127.0.0.1", port, value, "Plain", 5));
+	service.Delete();
+
+	auto valid = MakeIRPCService(functions);
+	CHECK(valid.Collisions().empty());
+	CHECK(valid.Start(port, 1, 2));
+	CHECK(RPC("127.0.0.1", port, value, "Plain", 5) && value == 5);
+	valid.Delete();
+}
+
+int main()
+{
+	RUN(hits(CACHE_PORT));
+	RUN(expiry(CACHE_PORT + 1));
+	RUN(eviction(CACHE_PORT + 2));
+	RUN(collisions(CACHE_PORT + 3));
+	return RESULT();
+}
@@ -0,0 +1,215 @@
+#include <rpc-service/RPCService.h>
+#include <rpc-service/RPCClient.h>
+#include <rpc-service/RPCFunction.h>
+#include "RPCTest.h"
+
+#include <array>
+#include <climits>
+#include <map>
+#include <optional>
+#include <vector>
+
+// Ports of the services started by the test
+#define COMPACT_PORT 7661
+
+enum Color { RED = 1, BLUE = 300 };
+
+// Type with its own overloads, holding a string after its length
+struct Named
+{
+	str name;
+	int id;
+
+	bool operator==(const Named&) const = default;
+};
+
+str Marshall(Named raw)
+{	return Package(raw.id, (int)raw.name.size()) + raw.name;
+}
+
+Named Unmarshall(std::string_view data, int* size, Type<Named>)
+{	if (data.size() < 8 || data.size() - 8 < (size_t)Load<int>(data.data() + 4))
+	{	*size = -1;
+		return Named{};
+	}
+	int length = Load<int>(data.data() + 4);
+	*size = 8 + length;
+	return Named{ str(data.data() + 8, length), Load<int>(data.data()) };
+}
+
+// Strings are only followed by other parameters in the compact encoding
+str Join(str left, int times, str right)
+{	str joined;
+	for (int i = 0; i < times; i++)
+	{	joined += left + right;
+	}
+	return joined;
+}
+
+std::map<str, int> Tally(std::vector<str> words)
+{	std::map<str, int> counts;
+	for (size_t i = 0; i < words.size(); i++)
+	{	counts[words[i]]++;
+	}
+	return counts;
+}
+
+Named Rename(Named named, str name)
+{	return Named{ name, named.id };
+}
+
+std::optional<int> Find(std::vector<int> values, int value)
+{	for (size_t i = 0; i < values.size(); i++)
+	{	if (values[i] == value)
+		{	return (int)i;
+		}
+	}
+	return std::nullopt;
+}
+
+static auto functions = std::make_tuple(
+	MakeFunction("Join", Type<str>(), Join, std::tuple<Type<str>, Type<int>, Type<str> >()),
+	MakeFunction("Tally", Type<std::map<str, int> >(), Tally, std::tuple<Type<std::vector<str> > >()),
+	MakeFunction("Find", Type<std::optional<int> >(), Find, std::tuple<Type<std::vector<int> >, Type<int> >()),
+	MakeFunction("Rename", Type<Named>(), Rename, std::tuple<Type<Named>, Type<str> >())
+);
+
+
+// Encodes the value alone and reads it back
+template<class T>
+static bool roundTrip(const T& value)
+{
+	str encoded = Compact(value);
+	T decoded = T();
+	return Extract(encoded, true, decoded) && decoded == value;
+}
+
+// Small integers take a byte or two whatever their width, and negative ones
+// stay short
+static void varints()
+{
+	CHECK(Compact(0).size() == 1);
+	CHECK(Compact(-1).size() == 1);
+	CHECK(Compact(63).size() == 1);
+	CHECK(Compact(300).size() == 2);
+	CHECK(Compact((long long)-5).size() == 1);
+	CHECK(Compact((unsigned short)127).size() == 1);
+
+	CHECK(roundTrip(0));
+	CHECK(roundTrip(-1));
+	CHECK(roundTrip(INT_MIN));
+	CHECK(roundTrip(INT_MAX));
+	CHECK(roundTrip(LLONG_MIN));
+	CHECK(roundTrip(ULLONG_MAX));
+	CHECK(roundTrip((short)-300));
+	CHECK(roundTrip(BLUE));
+	CHECK(roundTrip(2.5));
+	CHECK(roundTrip('x'));
+}
+
+// Strings and containers are prefixed with their size and nest freely
+static void containers()
+{
+	CHECK(roundTrip(str("")));
+	CHECK(roundTrip(str("id42")));
+	CHECK(roundTrip(str(100000, 'z')));
+	CHECK(roundTrip(std::vector<int>{ 1, -2, 300000, INT_MIN }));
+	CHECK(roundTrip(std::vector<double>{ 0.5, -1e300, 3.0 }));
+	CHECK(roundTrip(std::vector<bool>{ true, false, true }));
+	CHECK(roundTrip(std::vector<str>{ "a", "", "ccc" }));
+	CHECK(roundTrip(std::vector<std::vector<int> >{ { 1 }, {}, { 2, 3 } }));
+	CHECK(roundTrip(std::array<int, 3>{ 7, -8, 9 }));
+	CHECK(roundTrip(std::map<str, int>{ { "one", 1 }, { "two", 2 } }));
+	CHECK(roundTrip(std::optional<int>()));
+	CHECK(roundTrip(std::optional<str>("set")));
+	CHECK(roundTrip(std::pair<int, str>(3, "three")));
+	CHECK(roundTrip(std::make_tuple(1, str("two"), std::vector<short>{ 3, 4 })));
+}
+
+// Payloads cut short fail instead of being read out of bounds
+static void truncated()
+{
+	str encoded = Compact(std::vector<str>{ "abc", "defgh" });
+	std::vector<str> decoded;
+
+	for (size_t size = 0; size < encoded.size(); size++)
+	{	CHECK(!Extract(std::string_view(encoded).substr(0, size), true, decoded));
+	}
+	CHECK(Extract(encoded, true, decoded) && decoded.size() == 2);
+
+	// Types with their own overloads are only given the bytes left
+	Named named = Named{ "named", 7 };
+	str raw     = Marshall(named);
+	str compact = Compact(named);
+	Named read;
+
+	for (size_t size = 0; size < raw.size(); size++)
+	{	CHECK(!Extract(std::string_view(raw).substr(0, size), false, read));
+	}
+	for (size_t size = 0; size < compact.size(); size++)
+	{	CHECK(!Extract(std::string_view(compact).substr(0, size), true, read));
+	}
+	CHECK(Extract(raw, false, read) && read == named);
+	CHECK(Extract(compact, true, read) && read == named);
+
+	// A length past the payload fails instead of being read
+	str forged = Package(7, 1 << 20) + "short";
+	CHECK(!Extract(forged, false, read));
+}
+
+// Small numbers and short ids take half the bytes of the raw encoding or less
+static void size()
+{
+	str raw     = Package(1, 2, 3, str("id42"));
+	str compact = Compact(1, 2, 3, str("id42"));
+	CHECK(compact.size() * 2 <= raw.size());
+}
+
+// Calls in the compact encoding pass strings in any position and containers
+static void calls(int port, int ioThreads)
+{
+	auto service = MakeIRPCService(functions);
+	CHECK(service.Start(port, ioThreads, 2));
+
+	RPCClient client;
+	client.compact = true;
+
+	str joined;
+	CHECK(client.Call("127.0.0.1", port, joined, "Join", str("ab"), 2, str("c")));
+	CHECK(joined == "abcabc");
+
+	std::map<str, int> counts;
+	CHECK(client.Call("127.0.0.1", port, counts, "Tally", std::vector<str>{ "x", "y", "x" }));
+	CHECK(counts.size() == 2 && counts["x"] == 2 && counts["y"] == 1);
+
+	std::optional<int> found;
+	CHECK(client.Call("127.0.0.1", port, found, "Find", std::vector<int>{ 4, 5, 6 }, 6));
+	CHECK(found.has_value() && *found == 2);
+	CHECK(client.Call("127.0.0.1", port, found, "Find", std::vector<int>{ 4, 5, 6 }, 7));
+	CHECK(!found.has_value());
+
+	Named renamed;
+	CHECK(client.Call("127.0.0.1", port, renamed, "Rename", Named{ "old", 5 }, str("new")));
+	CHECK(renamed == (Named{ "new", 5 }));
+
+	// The raw encoding reads it up to the end of the request too
+	client.compact = false;
+	CHECK(client.Call("127.0.0.1", port, renamed, "Rename", Named{ "old", 6 }, str("raw")));
+	CHECK(renamed == (Named{ "raw", 6 }));
+
+	str reply;
+	CHECK(!client.Exchange("127.0.0.1", port, "Rename\n" + Package(5, 1 << 20) + "old", reply));
+
+	service.Delete();
+}
+
+int main()
+{
+	RUN(varints());
+	RUN(containers());
+	RUN(truncated());
+	RUN(size());
+	RUN(calls(COMPACT_PORT, 0));
+	RUN(calls(COMPACT_PORT + 1, 1));
+	return RESULT();
+}
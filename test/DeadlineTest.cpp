@@ -0,0 +1,154 @@
+#include <rpc-service/RPCService.h>
+#include <rpc-service/RPCClient.h>
+#include <rpc-service/RPCFunction.h>
+#include "RPCTest.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// Ports of the services started by the test
+#define DEADLINE_PORT 7671
+
+typedef std::chrono::steady_clock clk;
+
+// Number of times Count ran
+static std::atomic<int> counted(0);
+
+// Sleeps for the milliseconds given and returns them
+int Nap(int ms)
+{	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+	return ms;
+}
+
+int Count()
+{	return ++counted;
+}
+
+// Returns the milliseconds its caller has left, -1 if it waits forever
+int Budget()
+{	RPCClock::duration left = RPCRemaining();
+	return left == RPCClock::duration::max() ? -1 : (int)std::chrono::duration_cast<std::chrono::milliseconds>(left).count();
+}
+
+// Calls Nap on the port through a client of its own
+// Returns the milliseconds the call took
+int Relay(int port, int ms)
+{	RPCClient client;
+	int slept = 0;
+	auto begun = clk::now();
+	client.Call("127.0.0.1", port, slept, "Nap", ms);
+	return (int)std::chrono::duration_cast<std::chrono::milliseconds>(clk::now() - begun).count();
+}
+
+static auto functions = std::make_tuple(
+	MakeFunction("Nap", Type<int>(), Nap, std::tuple<Type<int> >()),
+	MakeFunction("Count", Type<int>(), Count, std::tuple<>()),
+	MakeFunction("Budget", Type<int>(), Budget, std::tuple<>()),
+	MakeFunction("Relay", Type<int>(), Relay, std::tuple<Type<int>, Type<int> >())
+);
+
+
+// A call whose reply takes longer than the client's timeout fails as expired
+// once the timeout passed, without waiting for the reply
+static void timeout(int port)
+{
+	RPCClient client;
+	client.timeout = 100;
+
+	int slept = 0;
+	auto begun = clk::now();
+	CHECK(!client.Call("127.0.0.1", port, slept, "Nap", 600));
+	CHECK(clk::now() - begun < std::chrono::milliseconds(400));
+
+	RPCResult<int> result = client.Async<int>("127.0.0.1", port, "Nap", 600).get();
+	CHECK(!result.ok && result.expired);
+
+	// The connections of the calls that expired may still be serving them
+	RPCClient other;
+	other.timeout = 100;
+	CHECK(other.Call("127.0.0.1", port, slept, "Nap", 1) && slept == 1);
+}
+
+// Functions read the time their caller has left, and calls they make end
+// no later than their caller
+static void budget(int port)
+{
+	RPCClient client;
+	int left = 0;
+	CHECK(client.Call("127.0.0.1", port, left, "Budget"));
+	CHECK(left == -1);
+
+	client.timeout = 1000;
+	CHECK(client.Call("127.0.0.1", port, left, "Budget"));
+	CHECK(left > 0 && left <= 1000);
+
+	// The relayed call gives up with the caller, well before Nap returns
+	RPCClient patient;
+	patient.timeout = 5000;
+	int took = 0;
+	CHECK(patient.Call("127.0.0.1", port, took, "Relay", port, 600));
+	CHECK(took >= 500);
+
+	RPCClient hurried;
+	hurried.timeout = 150;
+	auto begun = clk::now();
+	CHECK(!hurried.Call("127.0.0.1", port, took, "Relay", port, 600));
+	CHECK(clk::now() - begun < std::chrono::milliseconds(450));
+}
+
+// A request still waiting for a worker once its deadline passed is dropped
+// without running, and counted as expired
+static void dropped(int port)
+{
+	auto service = MakeIRPCService(functions);
+	CHECK(service.Start(port, 1, 1));
+	counted = 0;
+
+	// Keeps the only worker busy
+	RPCClient busy;
+	RPCTask<int> nap = busy.Async<int>("127.0.0.1", port, "Nap", 400);
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	RPCClient client;
+	client.timeout = 100;
+	int count = 0;
+	CHECK(!client.Call("127.0.0.1", port, count, "Count"));
+
+	RPCResult<int> slept = nap.get();
+	CHECK(slept.ok && slept.value == 400);
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	CHECK(counted == 0);
+
+	std::vector<RPCProcedureStats> stats = service.Stats();
+	bool found = false;
+	for (size_t i = 0; i < stats.size(); i++)
+	{	if (stats[i].name == "Count")
+		{	found = true;
+			CHECK(stats[i].expired == 1);
+		}
+	}
+	CHECK(found);
+
+	service.Delete();
+}
+
+// Serves the calls with deadlines in the mode given
+static void serve(int port, int ioThreads, int workerThreads)
+{
+	auto service = MakeIRPCService(functions);
+	CHECK(service.Start(port, ioThreads, workerThreads));
+
+	timeout(port);
+	budget(port);
+
+	service.Delete();
+}
+
+int main()
+{
+	RUN(serve(DEADLINE_PORT, 0, 0));
+	RUN(serve(DEADLINE_PORT + 1, 1, 4));
+	RUN(dropped(DEADLINE_PORT + 2));
+	return RESULT();
+}
@@ -0,0 +1,176 @@
+#include <rpc-service/RPCService.h>
+#include <rpc-service/RPCClient.h>
+#include <rpc-service/RPCFunction.h>
+#include <rpc-service/XThread.h>
+#include "RPCTest.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// Ports of the services started by the test
+#define DRAIN_PORT 7641
+
+// Number of calls in flight while the service drains
+#define DRAIN_CALLS 4
+
+typedef std::chrono::steady_clock clk;
+
+// Sleeps for the milliseconds given and returns them
+int Nap(int ms)
+{	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+	return ms;
+}
+
+static auto functions = std::make_tuple(
+	MakeFunction("Nap", Type<int>(), Nap, std::tuple<Type<int> >())
+);
+
+
+// Makes DRAIN_CALLS calls of Nap at once, each on a thread and a client of its own
+// Returns once every call is in flight
+static std::vector<std::thread> nap(int port, int ms, std::atomic<int>& succeeded)
+{
+	std::vector<std::thread> callers;
+	for (int i = 0; i < DRAIN_CALLS; i++)
+	{	callers.emplace_back([port, ms, &succeeded]()
+		{	RPCClient client;
+			int slept = 0;
+			if (client.Call("127.0.0.1", port, slept, "Nap", ms) && slept == ms)
+			{	succeeded++;
+			}
+		});
+	}
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	return callers;
+}
+
+// Calls in flight complete, and the drain returns once they did, well
+// within its timeout
+static void inFlight(int port, int ioThreads)
+{
+	auto service = MakeIRPCService(functions);
+	CHECK(service.Start(port, ioThreads, DRAIN_CALLS));
+
+	std::atomic<int> succeeded(0);
+	std::vector<std::thread> callers = nap(port, 300, succeeded);
+
+	auto begun = clk::now();
+	CHECK(service.Drain(2000));
+	CHECK(clk::now() - begun < std::chrono::milliseconds(2000));
+
+	for (size_t i = 0; i < callers.size(); i++)
+	{	callers[i].join();
+	}
+	CHECK(succeeded == DRAIN_CALLS);
+
+	// Nothing is served once drained
+	int slept = 0;
+	CHECK(!RPC("127.0.0.1", port, slept, "Nap", 1));
+
+	service.Delete();
+}
+
+// The drain reports calls still running at its deadline, and the service
+// only ends once they returned, so none outlives it and it can be started again
+static void pastDeadline(int port, int ioThreads)
+{
+	auto service = MakeIRPCService(functions);
+	CHECK(service.Start(port, ioThreads, DRAIN_CALLS));
+
+	std::atomic<int> succeeded(0);
+	std::vector<std::thread> callers = nap(port, 600, succeeded);
+
+	auto begun = clk::now();
+	CHECK(!service.Drain(100));
+	auto ended = clk::now() - begun;
+	CHECK(ended > std::chrono::milliseconds(300) && ended < std::chrono::milliseconds(2000));
+
+	for (size_t i = 0; i < callers.size(); i++)
+	{	callers[i].join();
+	}
+	// Connection threads can't send the replies of the calls past the deadline
+	CHECK(ioThreads > 0 || succeeded == 0);
+
+	CHECK(service.Start(port, ioThreads, DRAIN_CALLS));
+	int slept = 0;
+	CHECK(RPC("127.0.0.1", port, slept, "Nap", 1) && slept == 1);
+
+	service.Delete();
+}
+
+// A stopped pool finishes the task running and drops the queued ones
+static void dropped()
+{
+	XThreadPool pool;
+	CHECK(pool.Start(1));
+
+	std::atomic<int> ran(0);
+	CHECK(pool.Post([&ran]() { Nap(200); ran++; }));
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	for (int i = 0; i < 5; i++)
+	{	CHECK(pool.Post([&ran]() { ran++; }));
+	}
+
+	pool.Stop();
+	CHECK(ran == 1);
+	CHECK(!pool.Post([&ran]() { ran++; }));
+}
+
+// A service drained and started again under load serves the calls made
+// after the restart
+static void restart(int port, int ioThreads)
+{
+	auto service = MakeIRPCService(functions);
+	CHECK(service.Start(port, ioThreads, DRAIN_CALLS));
+
+	std::atomic<bool> restarted(false);
+	std::atomic<bool> done(false);
+	std::atomic<int>  after(0);
+	std::vector<std::thread> callers;
+
+	for (int i = 0; i < DRAIN_CALLS; i++)
+	{	callers.emplace_back([port, &restarted, &done, &after]()
+		{	RPCClient client;
+			while (!done)
+			{	bool serving = restarted;
+				int slept = 0;
+				if (client.Call("127.0.0.1", port, slept, "Nap", 5) && serving)
+				{	after++;
+				}
+			}
+		});
+	}
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	auto begun = clk::now();
+	CHECK(service.Drain(1000));
+	CHECK(clk::now() - begun < std::chrono::milliseconds(1000));
+
+	CHECK(service.Start(port, ioThreads, DRAIN_CALLS));
+	restarted = true;
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	done = true;
+
+	for (size_t i = 0; i < callers.size(); i++)
+	{	callers[i].join();
+	}
+	CHECK(after > 0);
+
+	service.Delete();
+}
+
+int main()
+{
+	RUN(inFlight(DRAIN_PORT, 0));
+	RUN(inFlight(DRAIN_PORT + 1, 1));
+	RUN(pastDeadline(DRAIN_PORT + 2, 0));
+	RUN(pastDeadline(DRAIN_PORT + 3, 1));
+	RUN(restart(DRAIN_PORT + 4, 0));
+	RUN(restart(DRAIN_PORT + 5, 1));
+	RUN(dropped());
+	return RESULT();
+}
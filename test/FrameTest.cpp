@@ -0,0 +1,105 @@
+#include <rpc-service/RPCService.h>
+#include <rpc-service/RPCClient.h>
+#include <rpc-service/RPCFunction.h>
+#include "RPCTest.h"
+
+#include <vector>
+
+// Ports of the services started by the test
+#define FRAME_PORT 7631
+
+str Echo(str data)
+{	return data;
+}
+
+static auto functions = std::make_tuple(
+	MakeFunction("Echo", Type<str>(), Echo, std::tuple<Type<str> >())
+);
+
+
+// Frames split across reads, and many frames in one read, are decoded whole
+static void decoding()
+{
+	str stream = MakeFrame(1, 0, "first") + MakeFrame(2, FRAME_COMPACT, "") + MakeFrame(3, 0, str(100000, 'c'));
+
+	FrameDecoder decoder;
+	std::vector<Frame> frames;
+	Frame frame;
+
+	for (size_t i = 0; i < stream.size(); i += 7)
+	{	decoder.Feed(stream.data() + i, std::min<size_t>(7, stream.size() - i));
+		while (decoder.Next(frame))
+		{	frames.push_back(frame);
+		}
+	}
+
+	CHECK(!decoder.failed);
+	CHECK(frames.size() == 3);
+	CHECK(frames.size() == 3 && frames[0].header.id == 1 && frames[0].payload == "first");
+	CHECK(frames.size() == 3 && frames[1].header.flags == FRAME_COMPACT && frames[1].payload.empty());
+	CHECK(frames.size() == 3 && frames[2].payload == str(100000, 'c'));
+}
+
+// A header announcing a large frame doesn't allocate it, and one announcing
+// more than the decoder accepts fails the stream
+static void oversized()
+{
+	char header[FRAME_HEADER];
+	WriteHeader(header, FrameHeader{ 1u << 30, 1, 0, 0 });
+
+	FrameDecoder large(1u << 30);
+	Frame frame;
+	large.Feed(header, FRAME_HEADER);
+	large.Feed("abc", 3);
+	CHECK(!large.Next(frame) && !large.failed);
+	CHECK(large.buffer.capacity() < (1 << 20));
+
+	FrameDecoder bounded;
+	bounded.Feed(header, FRAME_HEADER);
+	CHECK(!bounded.Next(frame) && bounded.failed);
+}
+
+// The service closes a client sending more than its limit before reading it,
+// while requests within the limit are served
+static void limited(int port, int ioThreads)
+{
+	auto service = MakeIRPCService(functions);
+	service.MaxFrame(64 << 10);
+	CHECK(service.Start(port, ioThreads, 2));
+
+	RPCClient client;
+	str echoed;
+	CHECK(client.Call("127.0.0.1", port, echoed, "Echo", str(32 << 10, 'a')));
+	CHECK(echoed.size() == (32 << 10));
+	CHECK(!client.Call("127.0.0.1", port, echoed, "Echo", str(128 << 10, 'a')));
+
+	// Only the header of a huge request is sent
+	IXSocket raw;
+	raw.Open(TCP, "127.0.0.1", port, 1000);
+	char header[FRAME_HEADER];
+	WriteHeader(header, FrameHeader{ 1u << 30, 1, 0, 0 });
+	raw.Send(str(header, FRAME_HEADER), FRAME_HEADER);
+
+	FrameHeader reply;
+	str payload;
+	raw.Timeout(5000);
+	CHECK(!RecvFrame(raw, reply, payload));
+	raw.Delete();
+
+	// Replies past the client's own limit fail the call
+	RPCClient strict;
+	strict.frameMax = 1 << 10;
+	CHECK(strict.Call("127.0.0.1", port, echoed, "Echo", str(100, 'b')));
+	CHECK(!strict.Call("127.0.0.1", port, echoed, "Echo", str(4 << 10, 'b')));
+
+	service.Delete();
+}
+
+int main()
+{
+	RUN(decoding());
+	RUN(oversized());
+	RUN(limited(FRAME_PORT, 0));
+	RUN(limited(FRAME_PORT + 1, 1));
+	return RESULT();
+}
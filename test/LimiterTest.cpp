@@ -0,0 +1,164 @@
+#include <rpc-service/RPCService.h>
+#include <rpc-service/RPCClient.h>
+#include <rpc-service/RPCFunction.h>
+#include <rpc-service/RPCLimiter.h>
+#include "RPCTest.h"
+
+#include <chrono>
+#include <thread>
+
+// Ports of the services started by the test
+#define LIMITER_PORT 7681
+
+typedef std::chrono::milliseconds ms;
+
+// Sleeps for the milliseconds given and returns them
+int Nap(int time)
+{	std::this_thread::sleep_for(ms(time));
+	return time;
+}
+
+int Plain(int a)
+{	return a;
+}
+
+static auto functions = std::make_tuple(
+	MakeFunction("Nap", Type<int>(), Nap, std::tuple<Type<int> >()),
+	MakeFunction("Plain", Type<int>(), Plain, std::tuple<Type<int> >())
+);
+
+
+// Returns the stats of the function of the service with the name
+template<class Service>
+static RPCProcedureStats stats(Service& service, const str& name)
+{
+	std::vector<RPCProcedureStats> all = service.Stats();
+	size_t index = 0;
+	while (index + 1 < all.size() && all[index].name != name)
+	{	index++;
+	}
+	return all[index];
+}
+
+
+// A fixed limit admits up to its number of requests and rejects the rest
+static void fixed()
+{
+	RPCLimiter limiter(2);
+	CHECK(limiter.Acquire());
+	CHECK(limiter.Acquire());
+	CHECK(!limiter.Acquire());
+	CHECK(limiter.rejected == 1);
+
+	limiter.Release(ms(1000));
+	CHECK(limiter.Limit() == 2);
+	CHECK(limiter.Acquire());
+
+	limiter.Cancel();
+	CHECK(limiter.inflight == 1);
+}
+
+// An adaptive limit drops once per target latency while requests are slow,
+// never below the floor, and grows back while fast requests come close to it
+static void adaptive()
+{
+	RPCLimiter limiter(100, ms(10), 50);
+
+	CHECK(limiter.Acquire());
+	limiter.Release(ms(20));
+	CHECK(limiter.Limit() == 90);
+
+	// Slow requests completing together only lower it once
+	CHECK(limiter.Acquire());
+	limiter.Release(ms(20));
+	CHECK(limiter.Limit() == 90);
+
+	for (int i = 0; i < 20; i++)
+	{	std::this_thread::sleep_for(ms(12));
+		CHECK(limiter.Acquire());
+		limiter.Release(ms(20));
+	}
+	CHECK(limiter.Limit() == 50);
+
+	for (int i = 0; i < 50; i++)
+	{	CHECK(limiter.Acquire());
+	}
+	for (int i = 0; i < 200; i++)
+	{	limiter.Release(ms(1));
+		CHECK(limiter.Acquire());
+	}
+	CHECK(limiter.Limit() >= 52 && limiter.Limit() <= 100);
+}
+
+// Requests past the service's limit, or a function's, are rejected straight
+// away as overloaded while the others are served. The stats of a function
+// count the calls its own limit rejected.
+static void limits(int port, int ioThreads)
+{
+	auto service = MakeIRPCService(functions);
+	service.Limit(1);
+	CHECK(service.Start(port, ioThreads, 4));
+	CHECK(service.Capacity() == 1);
+
+	RPCClient busy;
+	RPCTask<int> nap = busy.Async<int>("127.0.0.1", port, "Nap", 300);
+	std::this_thread::sleep_for(ms(100));
+
+	RPCClient client;
+	RPCResult<int> rejected = client.Async<int>("127.0.0.1", port, "Plain", 1).get();
+	CHECK(!rejected.ok && rejected.overloaded);
+	CHECK(nap.get().ok);
+
+	// The request is released just after its reply is sent
+	std::this_thread::sleep_for(ms(50));
+	int value = 0;
+	CHECK(client.Call("127.0.0.1", port, value, "Plain", 2) && value == 2);
+	service.Stop();
+
+	// Only the calls of the limited function are rejected
+	service.Limit(0);
+	CHECK(service.Limit("Nap", 1));
+	CHECK(!service.Limit("Missing", 1));
+	CHECK(service.Start(port, ioThreads, 4));
+
+	nap = busy.Async<int>("127.0.0.1", port, "Nap", 300);
+	std::this_thread::sleep_for(ms(100));
+
+	CHECK(client.Call("127.0.0.1", port, value, "Plain", 3) && value == 3);
+	rejected = client.Async<int>("127.0.0.1", port, "Nap", 1).get();
+	CHECK(!rejected.ok && rejected.overloaded);
+	CHECK(nap.get().ok);
+	CHECK(stats(service, "Nap").overloaded == 1);
+
+	service.Delete();
+}
+
+// The service's limit drops while requests are slower than the target
+static void adapts(int port, int ioThreads)
+{
+	auto service = MakeIRPCService(functions);
+	service.Limit(8);
+	service.Adapt(1, 2);
+	CHECK(service.Start(port, ioThreads, 4));
+	CHECK(service.Capacity() == 8);
+
+	RPCClient client;
+	int slept = 0;
+	for (int i = 0; i < 5; i++)
+	{	CHECK(client.Call("127.0.0.1", port, slept, "Nap", 5));
+	}
+	CHECK(service.Capacity() < 8 && service.Capacity() >= 2);
+
+	service.Delete();
+}
+
+int main()
+{
+	RUN(fixed());
+	RUN(adaptive());
+	RUN(limits(LIMITER_PORT, 0));
+	RUN(limits(LIMITER_PORT + 1, 1));
+	RUN(adapts(LIMITER_PORT + 2, 0));
+	RUN(adapts(LIMITER_PORT + 3, 1));
+	return RESULT();
+}
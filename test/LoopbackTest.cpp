@@ -0,0 +1,160 @@
+#include <rpc-service/RPCService.h>
+#include <rpc-service/RPCClient.h>
+#include <rpc-service/RPCFunction.h>
+#include "RPCTest.h"
+
+#include <map>
+#include <vector>
+
+// Ports of the services started by the test
+#define LOOPBACK_PORT 7601
+
+// Trivially copyable type sent as its bytes
+struct Point
+{
+	int   x;
+	float y;
+};
+
+float Divide(int a, int b)
+{	return (float)a / b;
+}
+
+str Echo(str data)
+{	return data;
+}
+
+int Count(std::vector<str> words, str word)
+{	int count = 0;
+	for (size_t i = 0; i < words.size(); i++)
+	{	count += words[i] == word ? 1 : 0;
+	}
+	return count;
+}
+
+// Views the rest of the request in place
+str Prefix(int count, std::string_view data)
+{	return str(data.substr(0, count));
+}
+
+Point Move(Point point, int dx)
+{	return Point{ point.x + dx, point.y * 2 };
+}
+
+void Nothing()
+{
+}
+
+static auto functions = std::make_tuple(
+	MakeFunction("Divide", Type<float>(), Divide, std::tuple<Type<int>, Type<int> >()),
+	MakeFunction("Echo", Type<str>(), Echo, std::tuple<Type<str> >()),
+	MakeFunction("Count", Type<int>(), Count, std::tuple<Type<std::vector<str> >, Type<str> >()),
+	MakeFunction("Prefix", Type<str>(), Prefix, std::tuple<Type<int>, Type<std::string_view> >()),
+	MakeFunction("Move", Type<Point>(), Move, std::tuple<Type<Point>, Type<int> >()),
+	MakeFunction("Nothing", Type<void>(), Nothing, std::tuple<>())
+);
+
+
+// Calls every function through a pooled client in the encoding given
+static void roundTrip(int port, bool compact)
+{
+	RPCClient client;
+	client.compact = compact;
+
+	float quotient = 0;
+	CHECK(client.Call("127.0.0.1", port, quotient, "Divide", 3, 6));
+	CHECK(quotient == 0.5f);
+
+	str small;
+	CHECK(client.Call("127.0.0.1", port, small, "Echo", str("hello")));
+	CHECK(small == "hello");
+
+	str empty = "x";
+	CHECK(client.Call("127.0.0.1", port, empty, "Echo", str()));
+	CHECK(empty.empty());
+
+	// Larger than a socket buffer, so it's read and written in parts
+	str large(1 << 20, 'a');
+	large[12345] = 'b';
+	str echoed;
+	CHECK(client.Call("127.0.0.1", port, echoed, "Echo", large));
+	CHECK(echoed == large);
+
+	int count = 0;
+	CHECK(client.Call("127.0.0.1", port, count, "Count", std::vector<str>{ "a", "b", "a" }, str("a")));
+	CHECK(count == 2);
+
+	str prefix;
+	CHECK(client.Call("127.0.0.1", port, prefix, "Prefix", 7, str("hello, world")));
+	CHECK(prefix == "hello, ");
+	CHECK(client.Call("127.0.0.1", port, prefix, "Prefix", 20, std::string_view("view")));
+	CHECK(prefix == "view");
+
+	Point moved = Point{ 0, 0 };
+	CHECK(client.Call("127.0.0.1", port, moved, "Move", Point{ 1, 1.5f }, 2));
+	CHECK(moved.x == 3 && moved.y == 3.0f);
+
+	CHECK(client.Call("127.0.0.1", port, "Nothing"));
+	CHECK(!client.Call("127.0.0.1", port, "Missing"));
+
+	auto task = client.Async<str>("127.0.0.1", port, "Echo", str("async"));
+	RPCResult<str> result = task.get();
+	CHECK(result.ok && result.value == "async");
+}
+
+// Calls through connections of their own, which use the raw encoding
+static void connectionPerCall(int port)
+{
+	float quotient = 0;
+	CHECK(RPC("127.0.0.1", port, quotient, "Divide", 1, 4));
+	CHECK(quotient == 0.25f);
+
+	str echoed;
+	CHECK(RPC("127.0.0.1", port, echoed, "Echo", str("direct")));
+	CHECK(echoed == "direct");
+
+	str prefix;
+	CHECK(RPC("127.0.0.1", port, prefix, "Prefix", 3, str("direct")));
+	CHECK(prefix == "dir");
+
+	CHECK(RPC("127.0.0.1", port, "Nothing"));
+	CHECK(!RPC("127.0.0.1", port, "Missing"));
+}
+
+// Serves the calls in the mode given and makes them in both encodings
+static void serve(int port, int ioThreads, int workerThreads)
+{
+	auto service = MakeIRPCService(functions);
+	CHECK(service.Start(port, ioThreads, workerThreads));
+
+	roundTrip(port, false);
+	roundTrip(port, true);
+	connectionPerCall(port);
+
+	service.Delete();
+}
+
+// A pooled connection the restarted service closed isn't used for the next call
+static void restart(int port)
+{
+	RPCClient client;
+	str echoed;
+
+	for (int i = 0; i < 10; i++)
+	{	auto service = MakeIRPCService(functions);
+		CHECK(service.Start(port, i % 2, 2));
+
+		CHECK(client.Call("127.0.0.1", port, echoed, "Echo", str("again")));
+		CHECK(echoed == "again");
+
+		service.Delete();
+	}
+}
+
+int main()
+{
+	RUN(serve(LOOPBACK_PORT, 0, 0));
+	RUN(serve(LOOPBACK_PORT + 1, 1, 2));
+	RUN(restart(LOOPBACK_PORT + 2));
+	return RESULT();
+}
@@ -0,0 +1,32 @@
+#ifndef RPCTEST_H
+#define RPCTEST_H
+
+#include <cstdio>
+
+// Checks shared by the test programs
+// Every test program listens on ports of its own, so ctest can run them
+// at the same time, and exits with 1 if any of its checks failed.
+
+// Number of checks that failed in the test program
+static int failures = 0;
+
+// Reports the check with its location if the condition doesn't hold
+#define CHECK(condition) \
+	do \
+	{	if (!(condition)) \
+		{	std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			failures++; \
+		} \
+	} while (0)
+
+// Runs a case of the test program, naming it in the output
+#define RUN(test) \
+	do \
+	{	std::printf("%s\n", #test); \
+		test; \
+	} while (0)
+
+// Exit code of the test program
+#define RESULT() (failures == 0 ? 0 : 1)
+
+#endif
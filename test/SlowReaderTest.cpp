@@ -0,0 +1,96 @@
+#include <rpc-service/RPCService.h>
+#include <rpc-service/RPCClient.h>
+#include <rpc-service/RPCFunction.h>
+#include "RPCTest.h"
+
+#include <chrono>
+#include <thread>
+
+// Ports of the services started by the test
+#define SLOW_PORT 7621
+
+// Number of large requests sent by the client that doesn't read
+#define SLOW_REQUESTS 32
+
+str Echo(str data)
+{	return data;
+}
+
+static auto functions = std::make_tuple(
+	MakeFunction("Echo", Type<str>(), Echo, std::tuple<Type<str> >())
+);
+
+
+// A client that never reads its replies doesn't hold up the workers, and is
+// disconnected once its queued replies pass the backlog
+static void backlog(int port)
+{
+	auto service = MakeIRPCService(functions);
+	service.Backlog(4 << 20);
+	CHECK(service.Start(port, 1, 1));
+
+	IXSocket slow;
+	slow.Open(TCP, "127.0.0.1", port, 1000);
+	CHECK(slow.good());
+
+	str request = "Echo\n" + Package(str(1 << 20, 'a'));
+	for (int i = 0; i < SLOW_REQUESTS && slow.good(); i++)
+	{	SendFrame(slow, i, 0, request);
+	}
+
+	// The only worker isn't waiting for the slow client to read
+	auto begun = std::chrono::steady_clock::now();
+	RPCClient client;
+	str reply;
+	CHECK(client.Call("127.0.0.1", port, reply, "Echo", str("fast")));
+	CHECK(reply == "fast");
+	CHECK(std::chrono::steady_clock::now() - begun < std::chrono::seconds(2));
+
+	// The replies written before the slow client was closed, then the end of the stream
+	FrameHeader header;
+	str payload;
+	int replies = 0;
+	slow.Timeout(5000);
+	while (RecvFrame(slow, header, payload))
+	{	replies++;
+	}
+	CHECK(replies < SLOW_REQUESTS);
+
+	slow.Delete();
+	service.Delete();
+}
+
+// Replies queued for a client that reads slowly are all written
+static void slowReads(int port)
+{
+	auto service = MakeIRPCService(functions);
+	CHECK(service.Start(port, 1, 1));
+
+	IXSocket slow;
+	slow.Open(TCP, "127.0.0.1", port, 1000);
+	CHECK(slow.good());
+
+	str data(1 << 20, 'b');
+	str request = "Echo\n" + Package(data);
+	for (int i = 0; i < 4; i++)
+	{	SendFrame(slow, i, 0, request);
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+	FrameHeader header;
+	str payload;
+	for (int i = 0; i < 4; i++)
+	{	CHECK(RecvFrame(slow, header, payload));
+		CHECK(header.id == (uint)i && payload == Package(data));
+	}
+
+	slow.Delete();
+	service.Delete();
+}
+
+int main()
+{
+	RUN(backlog(SLOW_PORT));
+	RUN(slowReads(SLOW_PORT + 1));
+	return RESULT();
+}